@@ -0,0 +1,195 @@
+//
+//  batch.c
+//  Visualiser
+//
+
+#include <stdlib.h>
+#include <string.h>
+#include <inttypes.h>
+#include <unistd.h>
+
+#include "batch.h"
+#include "sort.h"
+#include "stats.h"
+
+//-----------------------------------------------------
+/// Which sorter has this name
+static int batch_sorter_find(const char * const name){
+	for(int i = 0; i < sorter_count; i++){
+		if(0 == strcmp(name, sorters[i].name)){ return i; }
+	}
+	return -1;
+}
+
+//-----------------------------------------------------
+/// Add a job on the end, growing the list if it's full
+static struct batch_job *batch_add(struct batch * const b){
+	if(b->count == b->cap){
+		const int cap = b->cap ? b->cap * 2 : 16;
+		struct batch_job * const jobs = realloc(b->jobs, cap * sizeof(*jobs));
+		if(NULL == jobs){ return NULL; }
+		b->jobs = jobs;
+		b->cap = cap;
+	}
+	struct batch_job * const job = &b->jobs[b->count++];
+	memset(job, 0, sizeof(*job));
+	return job;
+}
+
+//-----------------------------------------------------
+bool batch_load(struct batch * const b, const char * const path){
+	memset(b, 0, sizeof(*b));
+
+	FILE * const in = 0 == strcmp(path, "-") ? stdin : fopen(path, "r");
+	if(NULL == in){
+		fprintf(stderr, "[%d] Couldn't open the job file %s\n", __LINE__, path);
+		return false;
+	}
+
+	char line[BATCH_LINE_LEN];
+	char sorter[BATCH_LINE_LEN];
+	char output[BATCH_LINE_LEN];
+	bool ok = true;
+	for(int number = 1; ok && NULL != fgets(line, sizeof(line), in); number++){
+		char * const hash = strchr(line, '#');
+		if(NULL != hash){ *hash = '\0'; }
+
+		int numbers = 0;
+		uint64_t seed = 0;
+		const int got = sscanf(line, "%s %d %" SCNu64 " %s", sorter, &numbers, &seed, output);
+		if(got <= 0){ continue; } // Blank, or only a comment
+
+		if(4 != got){
+			fprintf(stderr, "[%d] %s:%d needs a sorter, a size, a seed and an output\n", __LINE__, path, number);
+			ok = false;
+		}
+		else if(-1 == batch_sorter_find(sorter)){
+			fprintf(stderr, "[%d] %s:%d %s isn't a valid sort\n", __LINE__, path, number, sorter);
+			ok = false;
+		}
+		else if(numbers < 2){
+			fprintf(stderr, "[%d] %s:%d needs at least 2 elements\n", __LINE__, path, number);
+			ok = false;
+		}
+		else if(strlen(output) >= PPM_FILEPATH_BUFF_LEN){
+			fprintf(stderr, "[%d] %s:%d the output name is too long\n", __LINE__, path, number);
+			ok = false;
+		}
+		else{
+			struct batch_job * const job = batch_add(b);
+			if(NULL == job){
+				fprintf(stderr, "[%d] Out of memory for the job list\n", __LINE__);
+				ok = false;
+				break;
+			}
+			job->sorter = batch_sorter_find(sorter);
+			job->numbers = numbers;
+			job->seed = seed;
+			job->line = number;
+			strcpy(job->output, output);
+		}
+	}
+	if(ferror(in)){
+		fprintf(stderr, "[%d] Couldn't read all of %s\n", __LINE__, path);
+		ok = false;
+	}
+	if(in != stdin){ fclose(in); }
+
+	if(ok && 0 == b->count){
+		fprintf(stderr, "[%d] There are no jobs in %s\n", __LINE__, path);
+		ok = false;
+	}
+	if(!ok){ batch_free(b); }
+	return ok;
+}
+
+//-----------------------------------------------------
+void batch_fill(const struct batch_job * const job, const struct input_opts * const how, uint32_t arr[]){
+	struct input_opts opts = *how;
+	opts.seed = job->seed;
+	input_fill(arr, job->numbers, &opts);
+}
+
+//-----------------------------------------------------
+/// A worker, which takes jobs until there are none left
+static void *batch_worker(void *arg){
+	struct batch * const b = arg;
+
+	if(!radix_init(&radix_engine, b->radix_bits, b->radix_threads)){ return NULL; }
+
+	for(;;){
+		pthread_mutex_lock(&b->lock);
+		const int i = b->next < b->count ? b->next++ : -1;
+		pthread_mutex_unlock(&b->lock);
+		if(-1 == i){ break; }
+
+		struct batch_job * const job = &b->jobs[i];
+		const double start = stats_now_ms();
+		job->ok = b->run(job, b->ctx);
+		job->ms = stats_now_ms() - start;
+
+		if(job->ok){
+			fprintf(b->msg, "%s %d from line %d written to %s in %.1fms\n",
+					sorters[job->sorter].name, job->numbers, job->line, job->output, job->ms);
+		}
+		else{
+			fprintf(stderr, "[%d] The job on line %d, %s %d, failed\n", __LINE__, job->line, sorters[job->sorter].name, job->numbers);
+		}
+	}
+
+	radix_free(&radix_engine);
+	return NULL;
+}
+
+//-----------------------------------------------------
+int batch_run(struct batch * const b, int threads, const int radix_bits, const int radix_threads, batch_run_fn run, void *ctx, FILE * const msg){
+
+	if(threads <= 0){
+		threads = (int)sysconf(_SC_NPROCESSORS_ONLN);
+	}
+	if(threads > b->count){ threads = b->count; }
+	if(threads < 1){ threads = 1; }
+
+	pthread_t * const thread = calloc(threads, sizeof(*thread));
+	if(NULL == thread){
+		fprintf(stderr, "[%d] Out of memory for %d threads\n", __LINE__, threads);
+		return b->count;
+	}
+
+	b->next = 0;
+	b->radix_bits = radix_bits;
+	b->radix_threads = radix_threads;
+	b->run = run;
+	b->ctx = ctx;
+	b->msg = msg;
+	pthread_mutex_init(&b->lock, NULL);
+
+	// If a thread doesn't start the ones that did share out its jobs
+	b->threads = 0;
+	for(int t = 0; t < threads; t++){
+		if(0 != pthread_create(&thread[b->threads], NULL, batch_worker, b)){ break; }
+		b->threads++;
+	}
+	if(0 == b->threads){
+		fprintf(stderr, "[%d] Couldn't start any threads to run the jobs on\n", __LINE__);
+	}
+	for(int t = 0; t < b->threads; t++){
+		pthread_join(thread[t], NULL);
+	}
+
+	pthread_mutex_destroy(&b->lock);
+	free(thread);
+
+	int failed = 0;
+	for(int i = 0; i < b->count; i++){
+		failed += !b->jobs[i].ok;
+	}
+	return failed;
+}
+
+//-----------------------------------------------------
+void batch_free(struct batch * const b){
+	free(b->jobs);
+	b->jobs = NULL;
+	b->count = b->cap = 0;
+}
@@ -0,0 +1,106 @@
+//
+//  batch.h
+//  Visualiser
+//
+//  Runs a list of sorts, each to its own output, on a pool of threads. A job file
+//  has one job per line, "sorter numbers seed output", and # starts a comment.
+//  Each worker claims the next job under a lock and runs it start to finish, so
+//  jobs never share an array or a writer. The sort globals are per thread, and a
+//  worker sets up its own radix_engine before it runs anything.
+//
+
+#ifndef batch_h
+#define batch_h
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <pthread.h>
+
+#include "ppm.h"
+#include "input.h"
+
+#define BATCH_LINE_LEN						2048
+
+/**
+ One sort and where it goes
+ */
+struct batch_job{
+	int			sorter;								///< Index into sorters
+	int			numbers;							///< Length of the array
+	uint64_t	seed;								///< The same seed always gives the same array
+	char		output[PPM_FILEPATH_BUFF_LEN];		///< Without the extension
+	int			line;								///< Where it was in the job file
+	bool		ok;									///< Set once it has run
+	double		ms;									///< How long it took
+};
+
+struct batch;
+
+/**
+ Does one job, on whichever worker claimed it
+
+ @param job The job
+ @param ctx Whatever was given to batch_run
+ @return False if it failed
+ */
+typedef bool (*batch_run_fn)(struct batch_job * const job, void *ctx);
+
+/**
+ The jobs and the pool working through them
+ */
+struct batch{
+	struct batch_job	*jobs;
+	int					count;
+	int					cap;
+	int					threads;			///< Workers actually running
+	int					next;				///< First job nobody has claimed yet
+	int					radix_bits;			///< What each worker's radix_engine is set up with
+	int					radix_threads;		///< And how many threads it scatters on, 0 for one per core
+	batch_run_fn		run;
+	void				*ctx;
+	FILE				*msg;				///< Progress goes here
+	pthread_mutex_t		lock;
+};
+
+//-----------------------------------------------------
+/**
+ Read the jobs from a file
+
+ @param b The batch, which is cleared first
+ @param path The job file, - for stdin
+ @return False if the file couldn't be read or a line made no sense
+ */
+bool	batch_load(struct batch * const b, const char * const path);
+
+/**
+ Fill a job's array from its seed, with the same values every time
+
+ @param job The job
+ @param how The distribution every job uses, the seed is the job's own
+ @param arr Its array, job->numbers long
+ */
+void	batch_fill(const struct batch_job * const job, const struct input_opts * const how, uint32_t arr[]);
+
+/**
+ Run every job, and wait for them all to finish
+
+ @param b The loaded batch
+ @param threads How many jobs to run at once, 0 for one per core
+ @param radix_bits Digit width for each worker's radix_engine, 0 for the default
+ @param radix_threads Threads for each worker's radix_engine, 0 for one per core
+ @param run Does each job
+ @param ctx Given to run
+ @param msg Where to say what's finished
+ @return How many jobs failed
+ */
+int		batch_run(struct batch * const b, int threads, const int radix_bits, const int radix_threads, batch_run_fn run, void *ctx, FILE * const msg);
+
+/**
+ Free the job list
+
+ @param b The batch
+ */
+void	batch_free(struct batch * const b);
+
+#endif /* batch_h */
@@ -0,0 +1,397 @@
+//
+//  bench.c
+//  Visualiser
+//
+//  Runs the sorters over a grid of sizes and inputs and prints how long they take,
+//  as CSV or JSON, so one build can be compared against another. Each run is timed
+//  in one of these modes:
+//
+//  sort	The sort on its own, no frames
+//  prep	The sort plus building every frame's pixels, the way the gif-h path does
+//  idx		The sort plus encoding every frame with idxgif, like -p
+//  gif		The sort plus encoding every frame with gif-h, like the default
+//
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <getopt.h>
+#include <sys/stat.h>
+
+#include "ppm.h"
+#include "idxgif.h"
+#include "simd.h"
+#include "sort.h"
+#include "input.h"
+#include "gif-h/gif.h"
+
+#define BENCH_MAX_SIZES						32
+#define BENCH_MAX_SORTERS					32
+#define BENCH_MAX_REPS						1000
+#define BENCH_COLOURS						255		///< Inputs stick to this many colours so that idxgif can always have them
+#define BENCH_LIST_LEN						256
+
+/// What to time besides the sort
+enum bench_mode{
+	BENCH_MODE_SORT = 0,
+	BENCH_MODE_PREP,
+	BENCH_MODE_IDX,
+	BENCH_MODE_GIF,
+	BENCH_MODES
+};
+
+static const char * const bench_mode_names[BENCH_MODES] = { "sort", "prep", "idx", "gif" };
+
+/**
+ What the frame callbacks need, the same job render does in render.c
+ */
+struct bench{
+	int						n;
+	int						height;
+	int						lanes;				///< Strips in each of this sorter's frames, see sort_lanes
+	const char				*out_path;			///< Where the encoding modes write to
+	uint32_t				*frame;				///< n * height * lanes pixels
+	uint8_t					*frame_idx;			///< n * height * lanes palette indices
+	unsigned long			frames;				///< Frames built this run
+	struct idxgif_writer	idx_writer;
+	struct gif_writer		writer;
+};
+
+/**
+ One line of the results
+ */
+struct bench_result{
+	const char				*sorter;
+	enum input_dist			dist;
+	int						n;
+	enum bench_mode			mode;
+	int						reps;
+	double					min_ms;
+	double					median_ms;
+	double					p99_ms;
+	struct sort_counters	counts;				///< Compares, swaps and writes
+	unsigned long			frames;
+	long					bytes;				///< Size of the output, or 0 if nothing was written
+};
+
+static struct bench bench;
+
+//-----------------------------------------------------
+static double bench_now_ms(void){
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec * 1e3 + ts.tv_nsec / 1e6;
+}
+
+//-----------------------------------------------------
+static int bench_cmp_double(const void *a, const void *b){
+	const double da = *(const double *)a, db = *(const double *)b;
+	return (da > db) - (da < db);
+}
+
+//-----------------------------------------------------
+/// Lay out a frame's pixels, a strip per lane
+static void bench_build(const uint32_t arr[]){
+	for(int lane = 0; lane < bench.lanes; lane++){
+		uint32_t * const strip = &bench.frame[(size_t)lane * bench.n * bench.height];
+		simd_row_build(&arr[(size_t)lane * bench.n], strip, bench.n);
+		simd_rows_replicate(strip, (size_t)bench.n * sizeof(*strip), bench.height);
+	}
+}
+
+//-----------------------------------------------------
+static void bench_frame_prep(const uint32_t arr[], const int n){
+	bench_build(arr);
+	bench.frames++;
+}
+
+//-----------------------------------------------------
+static void bench_frame_idx(const uint32_t arr[], const int n){
+	for(int lane = 0; lane < bench.lanes; lane++){
+		uint8_t * const strip = &bench.frame_idx[(size_t)lane * bench.n * bench.height];
+		simd_row_indices(&arr[(size_t)lane * bench.n], strip, bench.n);
+		simd_rows_replicate(strip, bench.n, bench.height);
+	}
+	idxgif_write_rect(&bench.idx_writer, bench.frame_idx, 0, 0, bench.n, bench.height * bench.lanes, false);
+	bench.frames++;
+}
+
+//-----------------------------------------------------
+static void bench_frame_gif(const uint32_t arr[], const int n){
+	bench_build(arr);
+	gif_write_frame(&bench.writer, (uint8_t *)bench.frame, 8, false);
+	bench.frames++;
+}
+
+//-----------------------------------------------------
+/// Open the output for the modes which have one, and tag the array for idxgif
+static bool bench_begin(const enum bench_mode mode, uint32_t arr[], const int n){
+	if(BENCH_MODE_IDX == mode){
+		if(!idxgif_palette_build(&bench.idx_writer.palette, arr, n)){ return false; }
+		idxgif_palette_tag(&bench.idx_writer.palette, arr, n);
+		bench.idx_writer.delay = 0;
+		bench.idx_writer.size.width = n;
+		bench.idx_writer.size.height = bench.height * bench.lanes;
+		return idxgif_begin(&bench.idx_writer, bench.out_path);
+	}
+	if(BENCH_MODE_GIF == mode){
+		bench.writer.delay = 0;
+		bench.writer.size.width = n;
+		bench.writer.size.height = bench.height * bench.lanes;
+		return gif_begin(&bench.writer, bench.out_path);
+	}
+	return true;
+}
+
+//-----------------------------------------------------
+/// Close the output and say how big it came out
+static long bench_end(const enum bench_mode mode){
+	if(BENCH_MODE_IDX == mode){ idxgif_end(&bench.idx_writer); }
+	else if(BENCH_MODE_GIF == mode){ gif_end(&bench.writer); }
+	else{ return 0; }
+
+	struct stat st;
+	return 0 == stat(bench.out_path, &st) ? (long)st.st_size : -1;
+}
+
+//-----------------------------------------------------
+/// Time one sorter on one input in one mode
+static bool bench_run(const struct sorter * const s, const enum input_dist dist, const int n, const enum bench_mode mode,
+					  const int reps, const uint64_t seed, struct bench_result * const res){
+
+	static const gif_cb callbacks[BENCH_MODES] = { NULL, bench_frame_prep, bench_frame_idx, bench_frame_gif };
+
+	uint32_t *input = alloc_aligned((size_t)n * sizeof(*input));
+	uint32_t *arr = alloc_aligned((size_t)n * sizeof(*arr));
+	double *times = malloc(reps * sizeof(*times));
+	bool ok = input && arr && times;
+	if(!ok){ fprintf(stderr, "[%d] Out of memory for %d elements\n", __LINE__, n); }
+
+	if(ok){
+		const struct input_opts how = { .dist = dist, .seed = seed, .colours = BENCH_COLOURS };
+		input_fill(input, n, &how);
+	}
+	memset(res, 0, sizeof(*res));
+
+	for(int r = 0; ok && r < reps; r++){
+		memcpy(arr, input, (size_t)n * sizeof(*arr));
+		if(!bench_begin(mode, arr, n)){
+			fprintf(stderr, "[%d] Couldn't start the %s output at %s\n", __LINE__, bench_mode_names[mode], bench.out_path);
+			ok = false;
+			break;
+		}
+		bench.frames = 0;
+		memset(&sort_counts, 0, sizeof(sort_counts));
+
+		const double start = bench_now_ms();
+		s->perform[SORT_ASCENDING](arr, n, callbacks[mode]);
+		times[r] = bench_now_ms() - start;
+
+		res->bytes = bench_end(mode);
+		res->counts = sort_counts;
+		res->frames = bench.frames;
+	}
+
+	if(ok){
+		qsort(times, reps, sizeof(*times), bench_cmp_double);
+		res->sorter = s->name;
+		res->dist = dist;
+		res->n = n;
+		res->mode = mode;
+		res->reps = reps;
+		res->min_ms = times[0];
+		res->median_ms = times[reps / 2];
+		res->p99_ms = times[(int)(0.99 * (reps - 1) + 0.5)];
+	}
+
+	free(times);
+	free(arr);
+	free(input);
+	return ok;
+}
+
+//-----------------------------------------------------
+static void bench_print(FILE * const out, const struct bench_result * const r, const bool json, const bool first){
+	if(json){
+		fprintf(out, "%s\n  {\"sorter\": \"%s\", \"dist\": \"%s\", \"n\": %d, \"mode\": \"%s\", \"reps\": %d, "
+				"\"min_ms\": %.4f, \"median_ms\": %.4f, \"p99_ms\": %.4f, \"compares\": %lu, \"swaps\": %lu, \"writes\": %lu, \"frames\": %lu, \"bytes\": %ld}",
+				first ? "" : ",", r->sorter, input_dist_names[r->dist], r->n, bench_mode_names[r->mode], r->reps,
+				r->min_ms, r->median_ms, r->p99_ms, r->counts.compares, r->counts.swaps, r->counts.writes, r->frames, r->bytes);
+	}
+	else{
+		fprintf(out, "%s,%s,%d,%s,%d,%.4f,%.4f,%.4f,%lu,%lu,%lu,%lu,%ld\n",
+				r->sorter, input_dist_names[r->dist], r->n, bench_mode_names[r->mode], r->reps,
+				r->min_ms, r->median_ms, r->p99_ms, r->counts.compares, r->counts.swaps, r->counts.writes, r->frames, r->bytes);
+	}
+	fflush(out);
+}
+
+//-----------------------------------------------------
+/// Turn a comma separated list of names into flags against a table of them
+static bool bench_pick(char * const list, const char * const names[], const int count, bool picked[]){
+	memset(picked, 0, count * sizeof(*picked));
+	for(char *tok = strtok(list, ","); tok; tok = strtok(NULL, ",")){
+		int i = 0;
+		while(i < count && 0 != strcmp(tok, names[i])){ i++; }
+		if(i == count){
+			fprintf(stderr, "%s isn't one of the choices\n", tok);
+			return false;
+		}
+		picked[i] = true;
+	}
+	return true;
+}
+
+//-----------------------------------------------------
+static void bench_usage(void){
+	printf("Usage:\n"
+		   "\t-n\tSizes to run, comma separated, default 250,1000\n"
+		   "\t-s\tSorts to run, comma separated, default all of them but all\n"
+		   "\t-d\tInputs: uniform sorted reversed nearly few sawtooth organ, default all of them\n"
+		   "\t-m\tModes: sort prep idx gif, default all of them\n"
+		   "\t-r\tRepetitions of each, default 5\n"
+		   "\t-H\tFrame height in pixels, default 8\n"
+		   "\t-x\tSeed for the inputs, default 1\n"
+		   "\t-w\tThreads for the sorts which can use more than one, 0 for one per core\n"
+		   "\t-O\tWhere the encoding modes write to, default bench.gif\n"
+		   "\t-J\tWrite JSON rather than CSV\n"
+		   "\t-h\tHelp menu\n");
+}
+
+int main(int argc, char * const argv[]) {
+
+	char		sizes_arg[BENCH_LIST_LEN] = "250,1000";
+	char		*sorts_arg = NULL;
+	char		*dists_arg = NULL;
+	char		*modes_arg = NULL;
+	int			reps = 5;
+	uint64_t	seed = 1;
+	bool		json = false;
+	int			c = 0;
+
+	bench.height = 8;
+	bench.out_path = "bench.gif";
+	opterr = 0;
+
+	while((c = getopt(argc, argv, "n:s:d:m:r:H:x:w:O:Jh")) != -1)
+	switch(c)
+	{
+		case 'n':
+			strncpy(sizes_arg, optarg, sizeof(sizes_arg) - 1);
+			break;
+		case 's':
+			sorts_arg = optarg;
+			break;
+		case 'd':
+			dists_arg = optarg;
+			break;
+		case 'm':
+			modes_arg = optarg;
+			break;
+		case 'r':
+			reps = atoi(optarg);
+			break;
+		case 'H':
+			bench.height = atoi(optarg);
+			break;
+		case 'x':
+			seed = strtoull(optarg, NULL, 10);
+			break;
+		case 'w':
+			sort_threads = atoi(optarg);
+			break;
+		case 'O':
+			bench.out_path = optarg;
+			break;
+		case 'J':
+			json = true;
+			break;
+		case 'h':
+			bench_usage();
+			return 0;
+		case '?':
+		default:
+			fprintf(stderr, "Unknown option or missing argument to -%c, try -h\n", optopt);
+			return 1;
+	}
+
+	if(reps < 1 || reps > BENCH_MAX_REPS || bench.height < 1){
+		fprintf(stderr, "Need 1 to %d repetitions and at least 1 pixel of height\n", BENCH_MAX_REPS);
+		return 1;
+	}
+
+	int sizes[BENCH_MAX_SIZES], size_count = 0;
+	for(char *tok = strtok(sizes_arg, ","); tok && size_count < BENCH_MAX_SIZES; tok = strtok(NULL, ",")){
+		sizes[size_count] = atoi(tok);
+		if(sizes[size_count] < 2){
+			fprintf(stderr, "%s is too small to sort\n", tok);
+			return 1;
+		}
+		size_count++;
+	}
+
+	// The last sorter is all, which is just the others racing
+	const char *sorter_names[BENCH_MAX_SORTERS];
+	bool sorts[BENCH_MAX_SORTERS], dists[INPUT_DISTS], modes[BENCH_MODES];
+	if(sorter_count > BENCH_MAX_SORTERS){
+		fprintf(stderr, "[%d] Only room for %d sorters, there are %zu\n", __LINE__, BENCH_MAX_SORTERS, sorter_count);
+		return 1;
+	}
+	for(size_t i = 0; i < sorter_count; i++){
+		sorter_names[i] = sorters[i].name;
+		sorts[i] = i < sorter_count - 1;
+	}
+	for(int i = 0; i < INPUT_DISTS; i++){ dists[i] = true; }
+	for(int i = 0; i < BENCH_MODES; i++){ modes[i] = true; }
+	if(sorts_arg && !bench_pick(sorts_arg, sorter_names, (int)sorter_count, sorts)){ return 1; }
+	if(dists_arg && !bench_pick(dists_arg, input_dist_names, INPUT_DISTS, dists)){ return 1; }
+	if(modes_arg && !bench_pick(modes_arg, bench_mode_names, BENCH_MODES, modes)){ return 1; }
+
+	if(!radix_init(&radix_engine, RADIX_DEFAULT_BITS, sort_threads)){ return 1; }
+
+	if(json){ printf("["); }
+	else{ printf("sorter,dist,n,mode,reps,min_ms,median_ms,p99_ms,compares,swaps,writes,frames,bytes\n"); }
+
+	bool first = true;
+	int rc = 0;
+	for(int z = 0; z < size_count; z++){
+		const int n = sizes[z];
+		// Room for the race, which has the most strips
+		const size_t len = (size_t)n * bench.height * (sorter_count - 1);
+		bench.n = n;
+		bench.frame = alloc_aligned(len * sizeof(*bench.frame));
+		bench.frame_idx = alloc_aligned(len * sizeof(*bench.frame_idx));
+		if(!bench.frame || !bench.frame_idx){
+			fprintf(stderr, "[%d] Out of memory for a %d by %d frame\n", __LINE__, n, bench.height);
+			rc = 1;
+			break;
+		}
+
+		for(size_t s = 0; s < sorter_count; s++){
+			if(!sorts[s]){ continue; }
+			bench.lanes = sort_lanes((int)s);
+			for(int d = 0; d < INPUT_DISTS; d++){
+				if(!dists[d]){ continue; }
+				for(int m = 0; m < BENCH_MODES; m++){
+					if(!modes[m]){ continue; }
+					struct bench_result res;
+					if(!bench_run(&sorters[s], d, n, m, reps, seed, &res)){
+						rc = 1;
+						continue;
+					}
+					bench_print(stdout, &res, json, first);
+					first = false;
+				}
+			}
+		}
+
+		free(bench.frame);
+		free(bench.frame_idx);
+	}
+
+	if(json){ printf("\n]\n"); }
+	if(modes[BENCH_MODE_IDX] || modes[BENCH_MODE_GIF]){ remove(bench.out_path); }
+	radix_free(&radix_engine);
+	return rc;
+}
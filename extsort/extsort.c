@@ -0,0 +1,275 @@
+//
+//  extsort.c
+//  Visualiser
+//
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <limits.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "extsort.h"
+
+/**
+ The front of a run in the merge
+ */
+struct extsort_head{
+	uint32_t	key;
+	uint32_t	run;
+};
+
+//-----------------------------------------------------
+/// Where sample i of the view comes from
+static inline size_t extsort_sample(const struct extsort * const e, const int i){
+	return (size_t)i * e->n / e->width;
+}
+
+//-----------------------------------------------------
+/// Let the kernel drop the pages a part of a mapping has finished with. It's a shared
+/// file mapping, so the dirty ones are written back rather than lost.
+static void extsort_release(uint32_t * const p, const size_t n){
+	const uintptr_t page = (uintptr_t)sysconf(_SC_PAGESIZE);
+	const uintptr_t lo = ((uintptr_t)p + page - 1) & ~(page - 1);
+	const uintptr_t hi = ((uintptr_t)(p + n)) & ~(page - 1);
+	if(hi > lo){ madvise((void *)lo, hi - lo, MADV_DONTNEED); }
+}
+
+//-----------------------------------------------------
+/// Write all of a buffer at an offset, however many goes it takes
+static bool extsort_write(const int fd, const uint32_t buf[], const size_t n, const size_t at){
+	const char *p = (const char *)buf;
+	size_t left = n * sizeof(*buf);
+	off_t off = (off_t)(at * sizeof(*buf));
+	while(left > 0){
+		const ssize_t done = pwrite(fd, p, left, off);
+		if(done < 0){
+			if(EINTR == errno){ continue; }
+			return false;
+		}
+		p += done;
+		left -= (size_t)done;
+		off += done;
+	}
+	return true;
+}
+
+//-----------------------------------------------------
+/// Smaller key first, then the earlier run so that equal keys keep their order
+static inline bool extsort_before(const struct extsort_head a, const struct extsort_head b){
+	sort_counts.compares++;
+	return a.key < b.key || (a.key == b.key && a.run < b.run);
+}
+
+//-----------------------------------------------------
+/// Move an entry in the heap down to where it belongs
+static void extsort_sift(struct extsort_head heap[], const size_t n, size_t i){
+	const struct extsort_head top = heap[i];
+	for(size_t c = 2 * i + 1; c < n; c = 2 * i + 1){
+		if(c + 1 < n && extsort_before(heap[c + 1], heap[c])){ c++; }
+		if(!extsort_before(heap[c], top)){ break; }
+		heap[i] = heap[c];
+		i = c;
+	}
+	heap[i] = top;
+}
+
+//-----------------------------------------------------
+bool extsort_open(struct extsort * const e, const char * const path, const int width, const size_t mem){
+	memset(e, 0, sizeof(*e));
+	e->fd = -1;
+	e->path = path;
+
+	e->fd = open(path, O_RDWR);
+	if(-1 == e->fd){
+		fprintf(stderr, "[%d] Couldn't open %s to sort it\n", __LINE__, path);
+		return false;
+	}
+	struct stat st;
+	if(0 != fstat(e->fd, &st) || st.st_size % sizeof(uint32_t) || st.st_size < 2 * (off_t)sizeof(uint32_t)){
+		fprintf(stderr, "[%d] %s has to be at least 2 whole 4 byte pixels\n", __LINE__, path);
+		extsort_close(e);
+		return false;
+	}
+	e->n = (size_t)st.st_size / sizeof(uint32_t);
+
+	e->map = mmap(NULL, e->n * sizeof(*e->map), PROT_READ | PROT_WRITE, MAP_SHARED, e->fd, 0);
+	if(MAP_FAILED == e->map){
+		e->map = NULL;
+		fprintf(stderr, "[%d] Couldn't map %s\n", __LINE__, path);
+		extsort_close(e);
+		return false;
+	}
+	madvise(e->map, e->n * sizeof(*e->map), MADV_SEQUENTIAL);
+
+	// The sorts take an int length
+	e->run_len = mem / (EXTSORT_WORDS_PER_ELEMENT * sizeof(uint32_t));
+	if(e->run_len < 2){ e->run_len = 2; }
+	if(e->run_len > INT_MAX){ e->run_len = INT_MAX; }
+	if(e->run_len > e->n){ e->run_len = e->n; }
+	e->runs = (e->n + e->run_len - 1) / e->run_len;
+
+	e->width = (size_t)width < e->n ? width : (int)e->n;
+	e->view = alloc_aligned((size_t)e->width * sizeof(*e->view));
+	if(NULL == e->view){
+		fprintf(stderr, "[%d] Out of memory for a view %d wide\n", __LINE__, e->width);
+		extsort_close(e);
+		return false;
+	}
+	for(int i = 0; i < e->width; i++){
+		e->view[i] = e->map[extsort_sample(e, i)];
+	}
+	return true;
+}
+
+//-----------------------------------------------------
+/// Sort each run in memory and put it in dst, with a frame after each
+static bool extsort_runs(struct extsort * const e, sort_fn run_sort, uint32_t dst[], gif_cb cb){
+	uint32_t * const buf = alloc_aligned(e->run_len * sizeof(*buf));
+	if(NULL == buf){
+		fprintf(stderr, "[%d] Out of memory for a run of %zu elements\n", __LINE__, e->run_len);
+		return false;
+	}
+
+	int sample = 0;
+	for(size_t lo = 0; lo < e->n; lo += e->run_len){
+		const size_t len = e->n - lo < e->run_len ? e->n - lo : e->run_len;
+		memcpy(buf, &e->map[lo], len * sizeof(*buf));
+		run_sort(buf, (int)len, NULL);
+		memcpy(&dst[lo], buf, len * sizeof(*buf));
+		sort_counts.writes += len;
+		extsort_release(&e->map[lo], len);
+		if(dst != e->map){ extsort_release(&dst[lo], len); }
+
+		for(; sample < e->width && extsort_sample(e, sample) < lo + len; sample++){
+			e->view[sample] = buf[extsort_sample(e, sample) - lo];
+		}
+		if(cb){ cb(e->view, e->width); }
+	}
+
+	free(buf);
+	return true;
+}
+
+//-----------------------------------------------------
+/// Merge the runs in src back into the file, writing it out a buffer at a time
+static bool extsort_merge(struct extsort * const e, const uint32_t src[], const unsigned long frames, gif_cb cb){
+	struct extsort_head * const heap = calloc(e->runs, sizeof(*heap));
+	size_t * const next = calloc(e->runs, sizeof(*next));
+	uint32_t * const out = alloc_aligned(EXTSORT_WRITE_LEN * sizeof(*out));
+	if(!heap || !next || !out){
+		fprintf(stderr, "[%d] Out of memory to merge %zu runs\n", __LINE__, e->runs);
+		free(heap);
+		free(next);
+		free(out);
+		return false;
+	}
+
+	// Every run has at least one element, and they're already in order of run
+	size_t live = e->runs;
+	for(size_t r = 0; r < e->runs; r++){
+		next[r] = r * e->run_len;
+		heap[r].key = ppm_pix_get_average((union pixel_t)src[next[r]]);
+		heap[r].run = (uint32_t)r;
+	}
+	for(size_t i = live / 2; i-- > 0; ){ extsort_sift(heap, live, i); }
+
+	const size_t every = frames > 0 && e->n / frames > 0 ? e->n / frames : 1;
+	bool ok = true;
+	size_t buffered = 0, written = 0;
+	int sample = 0;
+	for(size_t pos = 0; pos < e->n; pos++){
+		const uint32_t r = heap[0].run;
+		const uint32_t value = src[next[r]++];
+		out[buffered++] = value;
+		sort_counts.writes++;
+
+		const size_t end = (r + 1) * e->run_len < e->n ? (r + 1) * e->run_len : e->n;
+		if(next[r] < end){
+			heap[0].key = ppm_pix_get_average((union pixel_t)src[next[r]]);
+		}
+		else{
+			heap[0] = heap[--live];
+		}
+		extsort_sift(heap, live, 0);
+
+		if(EXTSORT_WRITE_LEN == buffered){
+			ok = extsort_write(e->fd, out, buffered, written);
+			if(!ok){ break; }
+			written += buffered;
+			buffered = 0;
+		}
+
+		if(sample < e->width && extsort_sample(e, sample) == pos){
+			e->view[sample++] = value;
+		}
+		if(cb && ((pos + 1) % every == 0 || pos + 1 == e->n)){ cb(e->view, e->width); }
+	}
+	if(ok && buffered > 0){ ok = extsort_write(e->fd, out, buffered, written); }
+	if(!ok){
+		fprintf(stderr, "[%d] Couldn't write the merged runs back to %s\n", __LINE__, e->path);
+	}
+
+	free(heap);
+	free(next);
+	free(out);
+	return ok;
+}
+
+//-----------------------------------------------------
+bool extsort_sort(struct extsort * const e, sort_fn run_sort, const unsigned long frames, gif_cb cb){
+
+	// One run is sorted where it is
+	if(1 == e->runs){ return extsort_runs(e, run_sort, e->map, cb); }
+
+	// The runs go in a scratch file next to it, which is unlinked straight away so it never outlives the sort
+	const size_t bytes = e->n * sizeof(uint32_t);
+	const size_t len = strlen(e->path) + sizeof(".XXXXXX");
+	char * const name = malloc(len);
+	if(NULL == name){ return false; }
+	snprintf(name, len, "%s.XXXXXX", e->path);
+	const int fd = mkstemp(name);
+	if(-1 == fd){
+		fprintf(stderr, "[%d] Couldn't make a scratch file for the runs next to %s\n", __LINE__, e->path);
+		free(name);
+		return false;
+	}
+	unlink(name);
+	free(name);
+
+	uint32_t *runs = MAP_FAILED;
+	if(0 == ftruncate(fd, (off_t)bytes)){
+		runs = mmap(NULL, bytes, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+	}
+	if(MAP_FAILED == runs){
+		fprintf(stderr, "[%d] Couldn't make a %zu byte scratch file for the runs\n", __LINE__, bytes);
+		close(fd);
+		return false;
+	}
+	madvise(runs, bytes, MADV_SEQUENTIAL);
+
+	bool ok = extsort_runs(e, run_sort, runs, cb);
+	if(ok){
+		// Every run is read from at once now, a little from each at a time
+		madvise(runs, bytes, MADV_NORMAL);
+		ok = extsort_merge(e, runs, frames, cb);
+	}
+
+	munmap(runs, bytes);
+	close(fd);
+	return ok;
+}
+
+//-----------------------------------------------------
+void extsort_close(struct extsort * const e){
+	if(NULL != e->map){ munmap(e->map, e->n * sizeof(*e->map)); }
+	if(-1 != e->fd){ close(e->fd); }
+	free(e->view);
+	e->map = NULL;
+	e->view = NULL;
+	e->fd = -1;
+}
@@ -0,0 +1,72 @@
+//
+//  extsort.h
+//  Visualiser
+//
+//  Sorts a file of pixels in place, however big it is. The file is mapped rather
+//  than read, cut into runs that fit in the memory it's given, and each run is
+//  sorted in memory and put in a scratch file next to it. Then the runs are merged
+//  back into the file a buffer at a time. The frames are a view of the whole file
+//  sampled at evenly spaced points, so they're the same width however big it is.
+//
+
+#ifndef extsort_h
+#define extsort_h
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+#include "sort.h"
+
+#define EXTSORT_DEFAULT_MEM_MB				64
+#define EXTSORT_WORDS_PER_ELEMENT			4		///< A run being sorted takes about this many times its size, with the keys and scratch
+#define EXTSORT_MERGE_FRAMES				100		///< Frames spread over the merge, unless it's told otherwise
+#define EXTSORT_WRITE_LEN					(64 * 1024)	///< Elements the merge buffers up before each write
+
+/**
+ A file being sorted
+ */
+struct extsort{
+	int			fd;
+	const char	*path;
+	size_t		n;				///< Elements in the file
+	uint32_t	*map;			///< The file
+	size_t		run_len;		///< Elements in each run, the last can be shorter
+	size_t		runs;			///< How many there are
+	int			width;			///< Elements in the view
+	uint32_t	*view;			///< The file sampled at width evenly spaced points
+};
+
+//-----------------------------------------------------
+/**
+ Open and map a file of native endian uint32_t pixels and take the first view of it
+
+ @param e The sort
+ @param path The file, which gets sorted in place
+ @param width How many elements the view has, at most the length of the file
+ @param mem Bytes that a run can take while it's sorted
+ @return False if the file couldn't be opened or mapped, or isn't whole pixels
+ */
+bool	extsort_open(struct extsort * const e, const char * const path, const int width, const size_t mem);
+
+/**
+ Sort the file. Each run is sorted by run_sort, then the runs are merged on key, the
+ earlier run first when the keys match. The view goes to cb after each run is sorted
+ and frames times through the merge, but not before it starts.
+
+ @param e The sort
+ @param run_sort What sorts each run, smallest key first
+ @param frames How many frames to spread over the merge
+ @param cb Where the view goes, or NULL
+ @return False if the scratch file couldn't be made or written
+ */
+bool	extsort_sort(struct extsort * const e, sort_fn run_sort, const unsigned long frames, gif_cb cb);
+
+/**
+ Unmap and close the file
+
+ @param e The sort
+ */
+void	extsort_close(struct extsort * const e);
+
+#endif /* extsort_h */
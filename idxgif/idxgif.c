@@ -0,0 +1,461 @@
+//
+//  idxgif.c
+//  Visualiser
+//  https://www.w3.org/Graphics/GIF/spec-gif89a.txt
+//
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "idxgif.h"
+#include "ppm.h"
+
+/// Bit packer for the LZW code stream
+struct idxgif_bits{
+	struct idxgif_buf	*out;
+	uint32_t			acc;
+	int					count;
+};
+
+//-----------------------------------------------------
+static bool idxgif_buf_reserve(struct idxgif_buf * const buf, const size_t extra){
+	if(buf->len + extra <= buf->cap){ return true; }
+
+	size_t cap = buf->cap ? buf->cap : 4096;
+	while(cap < buf->len + extra){ cap *= 2; }
+
+	uint8_t *data = realloc(buf->data, cap);
+	if(!data){
+		fprintf(stderr, "[%d] Out of memory growing the frame buffer\n", __LINE__);
+		return false;
+	}
+	buf->data = data;
+	buf->cap = cap;
+	return true;
+}
+
+//-----------------------------------------------------
+static void idxgif_bits_put(struct idxgif_bits * const bits, const uint32_t code, const int size){
+	bits->acc |= code << bits->count;
+	bits->count += size;
+	while(bits->count >= 8){
+		bits->out->data[bits->out->len++] = (uint8_t)bits->acc;
+		bits->acc >>= 8;
+		bits->count -= 8;
+	}
+}
+
+//-----------------------------------------------------
+static void idxgif_put_u16(FILE * const fp, const int v){
+	fputc(v & 0xFF, fp);
+	fputc((v >> 8) & 0xFF, fp);
+}
+
+//-----------------------------------------------------
+void idxgif_buf_free(struct idxgif_buf * const buf){
+	free(buf->data);
+	buf->data = NULL;
+	buf->len = buf->cap = 0;
+}
+
+//-----------------------------------------------------
+uint8_t idxgif_palette_lookup(const struct idxgif_palette * const pal, const uint32_t colour){
+	union pixel_t want = (union pixel_t)colour;
+	if(pal->cube){
+		const int r = (want.r * (IDXGIF_CUBE_R - 1) + 127) / 255;
+		const int g = (want.g * (IDXGIF_CUBE_G - 1) + 127) / 255;
+		const int b = (want.b * (IDXGIF_CUBE_B - 1) + 127) / 255;
+		return (uint8_t)(IDXGIF_TRANSPARENT + 1 + (r * IDXGIF_CUBE_G + g) * IDXGIF_CUBE_B + b);
+	}
+	for(int i = 0; i < pal->count; i++){
+		union pixel_t p = (union pixel_t)pal->colour[i];
+		if(i != IDXGIF_TRANSPARENT && p.r == want.r && p.g == want.g && p.b == want.b){
+			return (uint8_t)i;
+		}
+	}
+	return IDXGIF_TRANSPARENT;
+}
+
+//-----------------------------------------------------
+bool idxgif_palette_build(struct idxgif_palette * const pal, const uint32_t arr[], const int n){
+
+	memset(pal, 0, sizeof(*pal));
+	pal->count = IDXGIF_TRANSPARENT + 1;
+
+	for(int i = 0; i < n; i++){
+		if(IDXGIF_TRANSPARENT != idxgif_palette_lookup(pal, arr[i])){ continue; }
+		if(pal->count == IDXGIF_MAX_COLOURS){ return false; }
+		pal->colour[pal->count++] = arr[i];
+	}
+
+	// GIF needs at least 2 bits per index
+	pal->depth = 2;
+	while((1 << pal->depth) < pal->count){ pal->depth++; }
+	return true;
+}
+
+//-----------------------------------------------------
+void idxgif_palette_cube(struct idxgif_palette * const pal){
+
+	memset(pal, 0, sizeof(*pal));
+	pal->count = IDXGIF_TRANSPARENT + 1;
+	for(int r = 0; r < IDXGIF_CUBE_R; r++){
+		for(int g = 0; g < IDXGIF_CUBE_G; g++){
+			for(int b = 0; b < IDXGIF_CUBE_B; b++){
+				union pixel_t p = { .rgbeol = 0 };
+				p.r = (uint8_t)(r * 255 / (IDXGIF_CUBE_R - 1));
+				p.g = (uint8_t)(g * 255 / (IDXGIF_CUBE_G - 1));
+				p.b = (uint8_t)(b * 255 / (IDXGIF_CUBE_B - 1));
+				pal->colour[pal->count++] = p.rgbeol;
+			}
+		}
+	}
+	pal->depth = 8;
+	pal->cube = true;
+}
+
+//-----------------------------------------------------
+void idxgif_palette_tag(const struct idxgif_palette * const pal, uint32_t arr[], const int n){
+	for(int i = 0; i < n; i++){
+		union pixel_t p = (union pixel_t)arr[i];
+		p.eol = idxgif_palette_lookup(pal, arr[i]);
+		arr[i] = p.rgbeol;
+	}
+}
+
+//-----------------------------------------------------
+bool idxgif_lzw_encode(struct idxgif_lzw * const lzw, const int min_code_size, const uint8_t idx[], const size_t count, struct idxgif_buf * const out){
+
+	const uint32_t clear = 1u << min_code_size;
+	const uint32_t eoi = clear + 1;
+
+	// Worst case is one code per index plus a clear every few thousand, at 12 bits each
+	if(!idxgif_buf_reserve(out, ((count + 2) * 12) / 8 + (count / 2048) * 3 + 8)){ return false; }
+
+	struct idxgif_bits bits = { out, 0, 0 };
+	int size = min_code_size + 1;
+	uint32_t max_code = eoi;
+
+	lzw->stamp++;
+	idxgif_bits_put(&bits, clear, size);
+
+	if(count == 0){
+		idxgif_bits_put(&bits, eoi, size);
+		if(bits.count > 0){ out->data[out->len++] = (uint8_t)bits.acc; }
+		return true;
+	}
+
+	uint32_t cur = idx[0];
+	for(size_t i = 1; i < count; i++){
+		const uint32_t key = (cur << 8) | idx[i];
+		uint32_t slot = (key * 2654435761u) & (IDXGIF_LZW_HASH_LEN - 1);
+
+		while(lzw->slot_stamp[slot] == lzw->stamp && lzw->slot_key[slot] != key){
+			slot = (slot + 1) & (IDXGIF_LZW_HASH_LEN - 1);
+		}
+
+		if(lzw->slot_stamp[slot] == lzw->stamp){
+			cur = lzw->slot_code[slot];
+			continue;
+		}
+
+		idxgif_bits_put(&bits, cur, size);
+
+		max_code++;
+		lzw->slot_stamp[slot] = lzw->stamp;
+		lzw->slot_key[slot] = key;
+		lzw->slot_code[slot] = (uint16_t)max_code;
+
+		if(max_code >= (1u << size)){ size++; }
+		if(max_code == IDXGIF_LZW_MAX_CODE){
+			idxgif_bits_put(&bits, clear, size);
+			size = min_code_size + 1;
+			max_code = eoi;
+			lzw->stamp++;
+		}
+		cur = idx[i];
+	}
+
+	// The decoder adds one more entry on reading the last code, and might grow the code size with it
+	idxgif_bits_put(&bits, cur, size);
+	if(max_code + 1 >= (1u << size)){ size++; }
+	idxgif_bits_put(&bits, eoi, size);
+	if(bits.count > 0){ out->data[out->len++] = (uint8_t)bits.acc; }
+
+	return true;
+}
+
+//-----------------------------------------------------
+bool idxgif_begin(struct idxgif_writer * const w, const char * const filename){
+
+	FILE * const fp = fopen(filename, "wb");
+	if(!fp){
+		perror("Error opening file\n");
+		return false;
+	}
+	return idxgif_begin_fp(w, fp);
+}
+
+//-----------------------------------------------------
+bool idxgif_begin_fp(struct idxgif_writer * const w, FILE * const fp){
+
+	w->fp = fp;
+	fputs("GIF89a", w->fp);
+
+	// Logical screen descriptor, with a global colour table
+	idxgif_put_u16(w->fp, w->size.width);
+	idxgif_put_u16(w->fp, w->size.height);
+	fputc(0xF0 | (w->palette.depth - 1), w->fp);
+	fputc(IDXGIF_TRANSPARENT, w->fp);	// Background colour
+	fputc(0, w->fp);					// Aspect ratio
+
+	for(int i = 0; i < (1 << w->palette.depth); i++){
+		union pixel_t p = (union pixel_t)(i < w->palette.count ? w->palette.colour[i] : 0);
+		fputc(p.r, w->fp);
+		fputc(p.g, w->fp);
+		fputc(p.b, w->fp);
+	}
+
+	// Netscape extension so it loops forever, only if it repeats, the same as gif-h
+	if(0 != w->delay){
+		fputc(0x21, w->fp);
+		fputc(0xFF, w->fp);
+		fputc(11, w->fp);
+		fputs("NETSCAPE2.0", w->fp);
+		fputc(3, w->fp);
+		fputc(1, w->fp);
+		idxgif_put_u16(w->fp, 0);
+		fputc(0, w->fp);
+	}
+
+	return true;
+}
+
+//-----------------------------------------------------
+bool idxgif_write_rect(struct idxgif_writer * const w, const uint8_t idx[], const int left, const int top, const int width, const int height, const bool transparent){
+
+	if(!w->fp){
+		fprintf(stderr, "[%d] Nothing in the &(FILE*)\n", __LINE__);
+		return false;
+	}
+
+	w->buf.len = 0;
+	if(!idxgif_lzw_encode(&w->lzw, w->palette.depth, idx, (size_t)width * height, &w->buf)){ return false; }
+
+	return idxgif_write_block(w, left, top, width, height, transparent, w->delay, &w->buf);
+}
+
+//-----------------------------------------------------
+bool idxgif_write_block(struct idxgif_writer * const w, const int left, const int top, const int width, const int height, const bool transparent, const unsigned int delay, const struct idxgif_buf * const data){
+
+	if(!w->fp){
+		fprintf(stderr, "[%d] Nothing in the &(FILE*)\n", __LINE__);
+		return false;
+	}
+
+	// Graphic control extension: don't dispose so that transparent pixels show the last frame
+	fputc(0x21, w->fp);
+	fputc(0xF9, w->fp);
+	fputc(4, w->fp);
+	fputc((1 << 2) | (transparent ? 1 : 0), w->fp);
+	idxgif_put_u16(w->fp, delay);
+	fputc(IDXGIF_TRANSPARENT, w->fp);
+	fputc(0, w->fp);
+
+	// Image descriptor, no local colour table
+	fputc(0x2C, w->fp);
+	idxgif_put_u16(w->fp, left);
+	idxgif_put_u16(w->fp, top);
+	idxgif_put_u16(w->fp, width);
+	idxgif_put_u16(w->fp, height);
+	fputc(0, w->fp);
+
+	// The image data, in sub blocks of up to 255 bytes
+	fputc(w->palette.depth, w->fp);
+	for(size_t off = 0; off < data->len; off += 255){
+		const size_t chunk = data->len - off < 255 ? data->len - off : 255;
+		fputc((int)chunk, w->fp);
+		fwrite(data->data + off, 1, chunk, w->fp);
+	}
+	fputc(0, w->fp);
+
+	return true;
+}
+
+//-----------------------------------------------------
+bool idxgif_end(struct idxgif_writer * const w){
+	if(!w->fp){ return false; }
+	fputc(0x3B, w->fp);
+	// Anything that didn't go in shows up here, a sink that stopped taking bytes say
+	bool ok = !ferror(w->fp);
+	ok &= 0 == fclose(w->fp);
+	w->fp = NULL;
+	idxgif_buf_free(&w->buf);
+	return ok;
+}
+
+//-----------------------------------------------------
+static void *idxgif_pool_run(void *arg){
+	struct idxgif_pool_worker * const me = arg;
+	struct idxgif_pool * const p = me->pool;
+
+	pthread_mutex_lock(&p->lock);
+	for(;;){
+		while(p->claimed == p->submitted && !p->done){
+			pthread_cond_wait(&p->work, &p->lock);
+		}
+		if(p->claimed == p->submitted){ break; }
+
+		struct idxgif_job * const job = &p->jobs[p->claimed++ % p->capacity];
+		job->state = IDXGIF_JOB_BUSY;
+		pthread_mutex_unlock(&p->lock);
+
+		job->out.len = 0;
+		job->ok = idxgif_lzw_encode(&me->lzw, p->w->palette.depth, job->idx, (size_t)job->width * job->height, &job->out);
+
+		pthread_mutex_lock(&p->lock);
+		job->state = IDXGIF_JOB_DONE;
+		pthread_cond_broadcast(&p->finished);
+	}
+	pthread_mutex_unlock(&p->lock);
+	return NULL;
+}
+
+//-----------------------------------------------------
+/// Write finished frames in order. If wait is set, block until the oldest one is done first.
+static void idxgif_pool_flush(struct idxgif_pool * const p, const bool wait){
+
+	pthread_mutex_lock(&p->lock);
+	while(p->written < p->submitted){
+		struct idxgif_job * const job = &p->jobs[p->written % p->capacity];
+		if(job->state != IDXGIF_JOB_DONE){
+			if(!wait){ break; }
+			pthread_cond_wait(&p->finished, &p->lock);
+			continue;
+		}
+
+		// Only the submitting thread writes, and nobody reuses the slot until written moves on
+		pthread_mutex_unlock(&p->lock);
+		const bool ok = job->ok && idxgif_write_block(p->w, job->left, job->top, job->width, job->height, job->transparent, job->delay, &job->out);
+		pthread_mutex_lock(&p->lock);
+
+		p->ok &= ok;
+		job->state = IDXGIF_JOB_EMPTY;
+		p->written++;
+		if(wait){ break; }
+	}
+	pthread_mutex_unlock(&p->lock);
+}
+
+//-----------------------------------------------------
+bool idxgif_pool_start(struct idxgif_pool * const p, struct idxgif_writer * const w, int threads){
+
+	if(threads <= 0){
+		threads = (int)sysconf(_SC_NPROCESSORS_ONLN);
+		if(threads <= 0){ threads = 1; }
+	}
+
+	memset(p, 0, sizeof(*p));
+	p->w = w;
+	p->ok = true;
+	p->capacity = threads * 4;
+	p->jobs = calloc(p->capacity, sizeof(*p->jobs));
+	p->worker = calloc(threads, sizeof(*p->worker));
+	if(!p->jobs || !p->worker){
+		fprintf(stderr, "[%d] Out of memory for %d compression threads\n", __LINE__, threads);
+		free(p->jobs);
+		free(p->worker);
+		return false;
+	}
+
+	pthread_mutex_init(&p->lock, NULL);
+	pthread_cond_init(&p->work, NULL);
+	pthread_cond_init(&p->finished, NULL);
+
+	for(int i = 0; i < threads; i++){
+		p->worker[i].pool = p;
+		if(0 != pthread_create(&p->worker[i].thread, NULL, idxgif_pool_run, &p->worker[i])){ break; }
+		p->threads++;
+	}
+
+	if(p->threads == 0){
+		fprintf(stderr, "[%d] Couldn't start any compression threads\n", __LINE__);
+		idxgif_pool_finish(p);
+		return false;
+	}
+	return true;
+}
+
+//-----------------------------------------------------
+bool idxgif_pool_write_rect(struct idxgif_pool * const p, const uint8_t idx[], const int left, const int top, const int width, const int height, const bool transparent){
+
+	// Keep the file moving, then make room if every slot is taken
+	idxgif_pool_flush(p, false);
+	pthread_mutex_lock(&p->lock);
+	const bool full = p->submitted - p->written == (uint64_t)p->capacity;
+	pthread_mutex_unlock(&p->lock);
+	if(full){ idxgif_pool_flush(p, true); }
+
+	// The slot is EMPTY, so no worker is looking at it
+	struct idxgif_job * const job = &p->jobs[p->submitted % p->capacity];
+	const size_t len = (size_t)width * height;
+	if(job->idx_cap < len){
+		uint8_t *buf = realloc(job->idx, len);
+		if(!buf){
+			fprintf(stderr, "[%d] Out of memory for a frame\n", __LINE__);
+			p->ok = false;
+			return false;
+		}
+		job->idx = buf;
+		job->idx_cap = len;
+	}
+	memcpy(job->idx, idx, len);
+	job->left = left;
+	job->top = top;
+	job->width = width;
+	job->height = height;
+	job->transparent = transparent;
+	job->delay = p->w->delay;
+
+	pthread_mutex_lock(&p->lock);
+	job->state = IDXGIF_JOB_QUEUED;
+	p->submitted++;
+	pthread_cond_signal(&p->work);
+	const bool ok = p->ok;
+	pthread_mutex_unlock(&p->lock);
+
+	return ok;
+}
+
+//-----------------------------------------------------
+bool idxgif_pool_finish(struct idxgif_pool * const p){
+
+	while(p->written < p->submitted){
+		idxgif_pool_flush(p, true);
+	}
+
+	pthread_mutex_lock(&p->lock);
+	p->done = true;
+	pthread_cond_broadcast(&p->work);
+	pthread_mutex_unlock(&p->lock);
+
+	for(int i = 0; i < p->threads; i++){
+		pthread_join(p->worker[i].thread, NULL);
+	}
+
+	for(int i = 0; i < p->capacity; i++){
+		free(p->jobs[i].idx);
+		idxgif_buf_free(&p->jobs[i].out);
+	}
+	pthread_cond_destroy(&p->finished);
+	pthread_cond_destroy(&p->work);
+	pthread_mutex_destroy(&p->lock);
+	free(p->jobs);
+	free(p->worker);
+	p->jobs = NULL;
+	p->worker = NULL;
+
+	return p->ok;
+}
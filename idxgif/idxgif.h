@@ -0,0 +1,275 @@
+//
+//  idxgif.h
+//  Visualiser
+//
+//  A small GIF89a writer which takes frames that are already palette indices,
+//  so unlike gif-h it never has to quantise anything. It also lets a frame be a
+//  sub-rectangle of the canvas, which is what the delta mode uses.
+//
+
+#ifndef idxgif_h
+#define idxgif_h
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stddef.h>
+#include <pthread.h>
+
+#define IDXGIF_MAX_COLOURS					256
+#define IDXGIF_TRANSPARENT					0		///< Palette slot reserved for "pixel unchanged"
+#define IDXGIF_LZW_MAX_CODE					4095
+#define IDXGIF_LZW_HASH_LEN					8192	///< Must be a power of two, and comfortably more than IDXGIF_LZW_MAX_CODE
+#define IDXGIF_CUBE_R						6		///< Levels of each channel in the colour cube, 6 * 7 * 6 fits beside the transparent slot
+#define IDXGIF_CUBE_G						7		///< The eye is keenest on green, so it gets the extra one
+#define IDXGIF_CUBE_B						6
+
+/**
+ The global colour table. Slot IDXGIF_TRANSPARENT is never a real colour.
+ */
+struct idxgif_palette{
+	int			count;							///< Used entries, including the transparent one
+	int			depth;							///< Bits per index, 2 - 8
+	bool		cube;							///< A fixed colour cube, so any colour has an index, the nearest
+	uint32_t	colour[IDXGIF_MAX_COLOURS];		///< Stored as pixel_t rgbeol values, eol ignored
+};
+
+/**
+ A growable byte buffer that compressed frame data goes into
+ */
+struct idxgif_buf{
+	uint8_t		*data;
+	size_t		len;
+	size_t		cap;
+};
+
+/**
+ The LZW string table. Entries are only valid if their stamp matches the current one,
+ so resetting the table on a clear code is just a counter increment.
+ */
+struct idxgif_lzw{
+	uint32_t	stamp;
+	uint32_t	slot_stamp[IDXGIF_LZW_HASH_LEN];
+	uint32_t	slot_key[IDXGIF_LZW_HASH_LEN];
+	uint16_t	slot_code[IDXGIF_LZW_HASH_LEN];
+};
+
+/**
+ The writer
+ */
+struct idxgif_writer{
+	FILE					*fp;
+	struct{
+		int width;
+		int height;
+	}						size;
+	unsigned int			delay;		///< In 100ths of a second, like gif-h
+	struct idxgif_palette	palette;
+	struct idxgif_lzw		lzw;
+	struct idxgif_buf		buf;
+};
+
+/// Where a frame is in the compression pool
+enum idxgif_job_state{
+	IDXGIF_JOB_EMPTY = 0,	///< Free to fill
+	IDXGIF_JOB_QUEUED,		///< Waiting for a worker
+	IDXGIF_JOB_BUSY,		///< Being compressed
+	IDXGIF_JOB_DONE			///< Compressed, waiting to be written in order
+};
+
+/**
+ A frame going through the compression pool
+ */
+struct idxgif_job{
+	enum idxgif_job_state	state;
+	uint8_t					*idx;
+	size_t					idx_cap;
+	int						left;
+	int						top;
+	int						width;
+	int						height;
+	bool					transparent;
+	unsigned int			delay;			///< The writer's delay when it was handed in
+	bool					ok;
+	struct idxgif_buf		out;
+};
+
+struct idxgif_pool;
+
+/**
+ A compression thread and its own string table
+ */
+struct idxgif_pool_worker{
+	struct idxgif_pool		*pool;
+	pthread_t				thread;
+	struct idxgif_lzw		lzw;
+};
+
+/**
+ Compresses frames on several threads at once. Frames only depend on the palette,
+ so they can be LZW'd in any order, then get spliced into the file in the order
+ they were submitted. Sequence numbers only ever go up, the slot is seq % capacity.
+ */
+struct idxgif_pool{
+	struct idxgif_writer	*w;
+	int						threads;
+	struct idxgif_pool_worker	*worker;
+	struct idxgif_job		*jobs;
+	int						capacity;
+	uint64_t				submitted;		///< Frames handed in
+	uint64_t				claimed;		///< Frames a worker has picked up
+	uint64_t				written;		///< Frames in the file
+	bool					done;
+	bool					ok;				///< Whether everything written so far went in
+	pthread_mutex_t			lock;
+	pthread_cond_t			work;			///< There's a frame to compress, or it's time to stop
+	pthread_cond_t			finished;		///< A frame has been compressed
+};
+
+//-----------------------------------------------------
+/**
+ Build a palette out of the distinct colours in an array
+
+ @param pal The palette to fill
+ @param arr The pixels
+ @param n The length of it
+ @return False if there are too many distinct colours to fit
+ */
+bool	idxgif_palette_build(struct idxgif_palette * const pal, const uint32_t arr[], const int n);
+
+/**
+ Make the palette a fixed colour cube, for when the colours won't fit one built
+ out of them. Every colour then has an index, the nearest in the cube.
+
+ @param pal The palette to fill
+ */
+void	idxgif_palette_cube(struct idxgif_palette * const pal);
+
+/**
+ Find a colour in the palette
+
+ @param pal The palette
+ @param colour The pixel_t rgbeol value, eol is ignored
+ @return The index, or IDXGIF_TRANSPARENT if it isn't there and it isn't a cube
+ */
+uint8_t	idxgif_palette_lookup(const struct idxgif_palette * const pal, const uint32_t colour);
+
+/**
+ Store each pixel's palette index in its eol byte, which nothing else uses, so that
+ writing a frame never needs to search the palette
+
+ @param pal The palette, built from the same pixels
+ @param arr The pixels
+ @param n The length of it
+ */
+void	idxgif_palette_tag(const struct idxgif_palette * const pal, uint32_t arr[], const int n);
+
+/**
+ Open the file and write the header, the global colour table and, if there's a delay,
+ the loop extension. The size, delay and palette need to be set before calling this.
+
+ @param w The writer
+ @param filename Where to write to
+ @return Success or not
+ */
+bool	idxgif_begin(struct idxgif_writer * const w, const char * const filename);
+
+/**
+ Same as idxgif_begin, but writing to a file that's already open. idxgif_end closes it.
+
+ @param w The writer
+ @param fp Where to write to
+ @return Success or not
+ */
+bool	idxgif_begin_fp(struct idxgif_writer * const w, FILE * const fp);
+
+/**
+ Write a frame, or part of one
+
+ @param w The writer
+ @param idx The palette indices, width * height of them row by row
+ @param left X offset of the rectangle in the canvas
+ @param top Y offset of the rectangle in the canvas
+ @param width The width of the rectangle
+ @param height The height of the rectangle
+ @param transparent Whether IDXGIF_TRANSPARENT pixels should show the previous frame through
+ @return Success or not
+ */
+bool	idxgif_write_rect(struct idxgif_writer * const w, const uint8_t idx[], const int left, const int top, const int width, const int height, const bool transparent);
+
+/**
+ Write a frame which has already been LZW compressed
+
+ @param w The writer
+ @param left X offset of the rectangle in the canvas
+ @param top Y offset of the rectangle in the canvas
+ @param width The width of the rectangle
+ @param height The height of the rectangle
+ @param transparent Whether IDXGIF_TRANSPARENT pixels should show the previous frame through
+ @param delay How long it shows for, in 100ths of a second
+ @param data The code stream from idxgif_lzw_encode
+ @return Success or not
+ */
+bool	idxgif_write_block(struct idxgif_writer * const w, const int left, const int top, const int width, const int height, const bool transparent, const unsigned int delay, const struct idxgif_buf * const data);
+
+/**
+ Write the trailer and close the file
+
+ @param w The writer
+ @return Success or not
+ */
+bool	idxgif_end(struct idxgif_writer * const w);
+
+/**
+ LZW compress a run of palette indices, appending the raw code stream to a buffer
+
+ @param lzw The string table to use
+ @param min_code_size The GIF minimum code size
+ @param idx The indices
+ @param count How many of them
+ @param out Where to put it
+ @return False if the buffer couldn't grow
+ */
+bool	idxgif_lzw_encode(struct idxgif_lzw * const lzw, const int min_code_size, const uint8_t idx[], const size_t count, struct idxgif_buf * const out);
+
+/**
+ Start the worker threads. The writer needs to have been begun already.
+
+ @param p The pool
+ @param w The writer the frames end up in
+ @param threads How many workers, 0 for one per core
+ @return Success or not
+ */
+bool	idxgif_pool_start(struct idxgif_pool * const p, struct idxgif_writer * const w, int threads);
+
+/**
+ Same as idxgif_write_rect, but the indices are copied and compressed on a worker.
+ Blocks only if every slot is still waiting on a worker.
+
+ @param p The pool
+ @param idx The palette indices, width * height of them row by row
+ @param left X offset of the rectangle in the canvas
+ @param top Y offset of the rectangle in the canvas
+ @param width The width of the rectangle
+ @param height The height of the rectangle
+ @param transparent Whether IDXGIF_TRANSPARENT pixels should show the previous frame through
+ @return False if an earlier frame failed to write
+ */
+bool	idxgif_pool_write_rect(struct idxgif_pool * const p, const uint8_t idx[], const int left, const int top, const int width, const int height, const bool transparent);
+
+/**
+ Write out everything still in flight, then stop the workers and free the pool
+
+ @param p The pool
+ @return Whether every frame made it in
+ */
+bool	idxgif_pool_finish(struct idxgif_pool * const p);
+
+/**
+ Free the buffer's memory
+
+ @param buf The buffer
+ */
+void	idxgif_buf_free(struct idxgif_buf * const buf);
+
+#endif /* idxgif_h */
@@ -0,0 +1,236 @@
+//
+//  input.c
+//  Visualiser
+//  https://prng.di.unimi.it/xoshiro256starstar.c
+//
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "input.h"
+#include "ppm.h"
+#include "sort.h"
+
+const char * const input_dist_names[INPUT_DISTS] = { "uniform", "sorted", "reversed", "nearly", "few", "sawtooth", "organ" };
+
+//-----------------------------------------------------
+static inline uint64_t input_rotl(const uint64_t x, const int k){
+	return (x << k) | (x >> (64 - k));
+}
+
+//-----------------------------------------------------
+void input_seed(struct input_rng * const r, const uint64_t seed){
+	// splitmix64 spreads the seed out, so the state is never all zeros
+	uint64_t state = seed;
+	for(int i = 0; i < 4; i++){
+		uint64_t z = (state += 0x9E3779B97F4A7C15ull);
+		z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ull;
+		z = (z ^ (z >> 27)) * 0x94D049BB133111EBull;
+		r->s[i] = z ^ (z >> 31);
+	}
+}
+
+//-----------------------------------------------------
+uint64_t input_next(struct input_rng * const r){
+	uint64_t * const s = r->s;
+	const uint64_t result = input_rotl(s[1] * 5, 7) * 9;
+	const uint64_t t = s[1] << 17;
+
+	s[2] ^= s[0];
+	s[3] ^= s[1];
+	s[1] ^= s[2];
+	s[0] ^= s[3];
+	s[2] ^= t;
+	s[3] = input_rotl(s[3], 45);
+
+	return result;
+}
+
+//-----------------------------------------------------
+uint32_t input_below(struct input_rng * const r, const uint64_t bound){
+	return (uint32_t)(((input_next(r) >> 32) * bound) >> 32);
+}
+
+//-----------------------------------------------------
+bool input_dist_parse(const char * const arg, struct input_opts * const opts){
+	const char * const colon = strchr(arg, ':');
+	const size_t len = colon ? (size_t)(colon - arg) : strlen(arg);
+	for(int i = 0; i < INPUT_DISTS; i++){
+		if(strlen(input_dist_names[i]) == len && 0 == strncmp(arg, input_dist_names[i], len)){
+			opts->dist = i;
+			opts->k = colon ? atoi(colon + 1) : 0;
+			return true;
+		}
+	}
+	return false;
+}
+
+//-----------------------------------------------------
+/// Key then colour, so that equal keys still come out the same every time
+static int input_cmp(const void *a, const void *b){
+	const uint64_t x = *(const uint64_t *)a, y = *(const uint64_t *)b;
+	return (x > y) - (x < y);
+}
+
+//-----------------------------------------------------
+/// Sort the array by key, smallest first
+static void input_sort(uint32_t arr[], const int n){
+	uint64_t * const tmp = malloc((size_t)n * sizeof(*tmp));
+	if(NULL == tmp){
+		fprintf(stderr, "[%d] Out of memory to lay out %d elements, they're left random\n", __LINE__, n);
+		return;
+	}
+	for(int i = 0; i < n; i++){
+		tmp[i] = (uint64_t)ppm_pix_get_average((union pixel_t)arr[i]) << 32 | arr[i];
+	}
+	qsort(tmp, n, sizeof(*tmp), input_cmp);
+	for(int i = 0; i < n; i++){
+		arr[i] = (uint32_t)tmp[i];
+	}
+	free(tmp);
+}
+
+//-----------------------------------------------------
+/// Reverse the array
+static void input_reverse(uint32_t arr[], const int n){
+	for(int i = 0, j = n - 1; i < j; i++, j--){
+		const uint32_t t = arr[i];
+		arr[i] = arr[j];
+		arr[j] = t;
+	}
+}
+
+//-----------------------------------------------------
+void input_fill(uint32_t arr[], const int n, const struct input_opts * const opts){
+	struct input_rng r;
+	input_seed(&r, opts->seed);
+
+	int colours = opts->colours;
+	if(INPUT_FEW == opts->dist){
+		colours = opts->k > 0 ? opts->k : INPUT_FEW_COLOURS;
+	}
+
+	// The colours, then the order
+	if(colours > 0){
+		uint32_t * const pool = malloc((size_t)colours * sizeof(*pool));
+		if(NULL != pool){
+			for(int i = 0; i < colours; i++){ pool[i] = (uint32_t)input_next(&r) & 0x00FFFFFF; }
+			for(int i = 0; i < n; i++){ arr[i] = pool[input_below(&r, colours)]; }
+			free(pool);
+		}
+		else{
+			colours = 0;
+		}
+	}
+	if(0 == colours){
+		for(int i = 0; i < n; i++){ arr[i] = (uint32_t)input_next(&r) & 0x00FFFFFF; }
+	}
+
+	switch(opts->dist){
+		case INPUT_UNIFORM:
+		case INPUT_FEW:
+		case INPUT_DISTS:
+			break;
+		case INPUT_SORTED:
+			input_sort(arr, n);
+			break;
+		case INPUT_REVERSED:
+			input_sort(arr, n);
+			input_reverse(arr, n);
+			break;
+		case INPUT_NEARLY:{
+			input_sort(arr, n);
+			const int swaps = opts->k > 0 ? opts->k : (n / 100 > 1 ? n / 100 : 1);
+			for(int s = 0; s < swaps; s++){
+				const uint32_t a = input_below(&r, n), b = input_below(&r, n);
+				const uint32_t t = arr[a];
+				arr[a] = arr[b];
+				arr[b] = t;
+			}
+			break;
+		}
+		case INPUT_SAWTOOTH:{
+			const int runs = opts->k > 0 ? opts->k : INPUT_SAWTOOTH_RUNS;
+			for(int t = 0; t < runs; t++){
+				const int lo = (int)((long)n * t / runs), hi = (int)((long)n * (t + 1) / runs);
+				input_sort(&arr[lo], hi - lo);
+			}
+			break;
+		}
+		case INPUT_ORGAN:{
+			// The evens go up the front half and the odds come back down the back half
+			input_sort(arr, n);
+			uint32_t * const tmp = malloc((size_t)n * sizeof(*tmp));
+			if(NULL == tmp){ break; }
+			for(int i = 0; i < n; i++){
+				tmp[i % 2 ? n - 1 - i / 2 : i / 2] = arr[i];
+			}
+			memcpy(arr, tmp, (size_t)n * sizeof(*arr));
+			free(tmp);
+			break;
+		}
+	}
+}
+
+//-----------------------------------------------------
+uint32_t *input_load(const char * const path, int * const n){
+	FILE * const in = 0 == strcmp(path, "-") ? stdin : fopen(path, "r");
+	if(NULL == in){
+		fprintf(stderr, "[%d] Couldn't open the input %s\n", __LINE__, path);
+		return NULL;
+	}
+
+	uint32_t *arr = NULL;
+	size_t len = 0, cap = 0;
+	bool ok = true;
+	char *line = NULL;
+	size_t line_cap = 0;
+	while(ok && -1 != getline(&line, &line_cap, in)){
+		char * const hash = strchr(line, '#');
+		if(NULL != hash){ *hash = '\0'; }
+
+		for(char *p = line; *p; ){
+			char *end;
+			const unsigned long v = strtoul(p, &end, 0);
+			if(end == p){ p++; continue; }
+			p = end;
+
+			if(len == cap){
+				cap = cap ? cap * 2 : 1024;
+				uint32_t * const grown = cap > INT32_MAX ? NULL : realloc(arr, cap * sizeof(*arr));
+				if(NULL == grown){
+					fprintf(stderr, "[%d] Out of memory reading %s\n", __LINE__, path);
+					ok = false;
+					break;
+				}
+				arr = grown;
+			}
+
+			union pixel_t px = { .r = (v >> 16) & 0xFF, .g = (v >> 8) & 0xFF, .b = v & 0xFF, .eol = 0 };
+			arr[len++] = px.rgbeol;
+		}
+	}
+	if(ferror(in)){
+		fprintf(stderr, "[%d] Couldn't read all of %s\n", __LINE__, path);
+		ok = false;
+	}
+	free(line);
+	if(in != stdin){ fclose(in); }
+
+	if(ok && 0 == len){
+		fprintf(stderr, "[%d] There's nothing to sort in %s\n", __LINE__, path);
+		ok = false;
+	}
+	if(!ok){
+		free(arr);
+		return NULL;
+	}
+
+	// Copied so it's cache line aligned like every other array that gets sorted
+	uint32_t * const out = alloc_aligned(len * sizeof(*out));
+	if(NULL != out){ memcpy(out, arr, len * sizeof(*out)); }
+	free(arr);
+	*n = (int)len;
+	return out;
+}
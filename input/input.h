@@ -0,0 +1,106 @@
+//
+//  input.h
+//  Visualiser
+//
+//  The arrays to sort. They come from xoshiro256**, seeded through splitmix64, so
+//  the same seed, length and distribution always give the same array whatever
+//  the machine. Or they can be read from a file of 0xRRGGBB colours.
+//
+
+#ifndef input_h
+#define input_h
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#define INPUT_DEFAULT_SEED					1
+#define INPUT_FEW_COLOURS					8		///< Distinct colours in few, unless it's given a k
+#define INPUT_SAWTOOTH_RUNS					4		///< Teeth in sawtooth, unless it's given a k
+
+/// How the array is laid out, by key
+enum input_dist{
+	INPUT_UNIFORM = 0,		///< Random
+	INPUT_SORTED,			///< Already in order
+	INPUT_REVERSED,			///< In order the other way round
+	INPUT_NEARLY,			///< In order apart from k random swaps, 1% of the length by default
+	INPUT_FEW,				///< Random, but only k distinct colours
+	INPUT_SAWTOOTH,			///< k sorted runs one after the other
+	INPUT_ORGAN,			///< Up to the middle then back down
+	INPUT_DISTS
+};
+
+/// The names of the distributions, as used on the command line
+extern const char * const input_dist_names[INPUT_DISTS];
+
+/**
+ The xoshiro256** state
+ */
+struct input_rng{
+	uint64_t	s[4];
+};
+
+/**
+ What to make
+ */
+struct input_opts{
+	enum input_dist	dist;
+	uint64_t		seed;
+	int				k;				///< Swaps for nearly, colours for few, runs for sawtooth, 0 for the default
+	int				colours;		///< Pick from this many random colours, 0 for any colour at all
+};
+
+//-----------------------------------------------------
+/**
+ Seed the generator
+
+ @param r The generator
+ @param seed Any value, 0 included
+ */
+void		input_seed(struct input_rng * const r, const uint64_t seed);
+
+/**
+ The next random number, xoshiro256**
+
+ @param r The generator
+ @return 64 random bits
+ */
+uint64_t	input_next(struct input_rng * const r);
+
+/**
+ A random number below a bound
+
+ @param r The generator
+ @param bound One more than the largest it can return, at most 2^32
+ @return The number
+ */
+uint32_t	input_below(struct input_rng * const r, const uint64_t bound);
+
+/**
+ Read a distribution from the command line
+
+ @param arg A name from input_dist_names, optionally followed by :k
+ @param opts Where the distribution and k go
+ @return False if the name isn't one
+ */
+bool		input_dist_parse(const char * const arg, struct input_opts * const opts);
+
+/**
+ Fill an array
+
+ @param arr The array
+ @param n The length of it
+ @param opts What to fill it with
+ */
+void		input_fill(uint32_t arr[], const int n, const struct input_opts * const opts);
+
+/**
+ Read an array from a file of colours, 0xRRGGBB or any other way strtoul reads a
+ number, separated by anything which isn't part of one. # starts a comment.
+
+ @param path The file, - for stdin
+ @param n Where the length goes
+ @return The array, free it with free(), or NULL if it couldn't be read or was empty
+ */
+uint32_t	*input_load(const char * const path, int * const n);
+
+#endif /* input_h */
@@ -6,20 +6,37 @@
 #include <stdio.h>
 #include <assert.h>
 #include <stdlib.h>
-#include <time.h>
 #include <stdbool.h>
 #include <string.h>
 #include <getopt.h>
+#include <unistd.h>
 
 #include "ppm.h"
-#include "gif-h/gif.h"
+#include "trace.h"
+#include "rawvid.h"
+#include "sort.h"
+#include "stats.h"
+#include "batch.h"
+#include "input.h"
+#include "extsort.h"
+#include "sink.h"
+#include "render.h"
+
+/**
+ What every job in a batch is rendered with
+ */
+struct batch_opts{
+    struct render_opts      render;             ///< Each job brings its own sorter
+    struct input_opts       input;              ///< The distribution, each job brings its own seed
+};
 
 // -----------------------------------------------------
-// These values are used in the gif_write_frame callback so they are defined globally
-static const int        numbers    = 250;           ///< Length of the array to sort
-static const int        height     = 50;            ///< Output image strip height
-static union pixel_t    gif[numbers * height];      ///< The Image buffer
-struct gif_writer       writer;                     ///< The writer
+// These values are used in the frame callbacks which only the command line has, so
+// they are defined globally. Everything else the callbacks need is in the render.
+static struct render                main_render;            ///< The frame buffers and writers, unless it's a batch
+struct trace                        tracer;                 ///< The trace being recorded
+static struct stats                 cli_stats;              ///< Where the time went while recording, or writing -P, which have no render
+static struct ppm_opts_t            row_ppm;                ///< The PPM with a row per frame, of -P
 
 /// The arguments as enum
 enum {  APP_NAME = 0,   ///< The first is always the application name
@@ -27,199 +44,272 @@ enum {  APP_NAME = 0,   ///< The first is always the application name
         ARG_COUNT       ///< There are only two args, but use this as a count value as comparison against argc.
 };
 
-typedef void (*gif_cb)(const uint32_t arr[], const int n);
-
-// ----------- SORTING LIFTED FROM INTERNET -----------
-/**
- A is greater than B
- @param a A value
- @param b B Value
- @return True/False
- */
-bool	gt_than(const uint32_t a, const uint32_t b);
-
-/**
- A is less than B
- 
- @param a A value
- @param b B Value
- @return True/False
- */
-bool	less_than(const uint32_t a, const uint32_t b);
-
-/**
- Swaps two variables contents
- 
- @param xp A, will have B
- @param yp B, will have A
- */
-void	swap(uint32_t * const xp, uint32_t * const yp);
-
-/**
- Bubble Sort from http://www.geeksforgeeks.org/bubble-sort/
- 
- @param arr The Array
- @param n Array Length
- @param test The compare function
- @param cb The callback to the function which actually writes it to the gif
- */
-void	bubble_sort(uint32_t arr[], int n, bool (*test)(uint32_t, uint32_t), gif_cb cb);
-
-/**
- Selection Sort from http://www.algolist.net/Algorithms/Sorting/Selection_sort
- 
- @param arr The Array
- @param n Array Length
- @param test The compare function
- @param cb The callback to the function which actually writes it to the gif
- */
-void	selctn_sort(uint32_t arr[], int n, bool (*test)(uint32_t, uint32_t), gif_cb cb);
-
-/**
- Puts the element at n in the correct place in the heap
-
- @param arr The array
- @param n The length of it
- @param i The thing to place
- @param test The evaluation function
- */
-void	heapify(uint32_t arr[], int n, const int i, bool (*test)(uint32_t, uint32_t));
-
-/**
- Heap sort from http://www.geeksforgeeks.org/heap-sort/
-
- @param arr The array to sort
- @param n The length of it
- @param test The evaluation function
- @param cb The callback to the function which actually writes it to the gif
- */
-void	heap_sort(uint32_t arr[], int n, bool (*test)(uint32_t, uint32_t), gif_cb cb);
-
-
-/**
- Merge the two asubarrays
-
- @param arr The total array
- @param l The left
- @param m The middle
- @param r The right
- @param test The evaluation function
- */
-void	merge(uint32_t arr[], int l, int m, int r, bool (*test)(uint32_t, uint32_t));
-
-/**
- Merge sort wrapper which allows it to have the same function signature as the rest.
- 
- @param arr The array to sort
- @param n The length of it
- @param cb The callback to the function which actually writes it to the gif
- */
-void merge_sort_wrapper(uint32_t arr[], int n, bool (*test)(uint32_t, uint32_t), gif_cb cb);
-
-/**
- Perform the mergesort http://www.geeksforgeeks.org/merge-sort/
-
- @param arr The array to sort
- @param l The left edge of the array
- @param r The right edge of the array
- @param test The evaluation function
- @param cb The callback to the function which actually writes it to the gif
- @param arr_len The length of the array
- */
-void	merge_sort(uint32_t arr[], int l, int r, bool (*test)(uint32_t, uint32_t), gif_cb cb, const int arr_len);
-
-/**
- Do a radix sort http://www.geeksforgeeks.org/radix-sort/
-
- @param arr The array to sort
- @param n It's length
- @param cb The callback to the function which actually writes it to the gif
- */
-void	radix_sort(uint32_t arr[], const int n, bool (*test)(uint32_t, uint32_t), gif_cb cb);
-
-/**
- Count sorts on the digits in the values of the array
-
- @param arr The Array to sort
- @param n The length of it
- @param exp The multiplier, eg the units, the tens, the hundreds
- @param cb The callback to the function which actually writes it to the gif
- */
-void	count_sort(uint32_t arr[], const int n, const int exp, gif_cb cb);
+/// Print the stats, or write them as JSON, if they were asked for
+/// @param s The stats
+/// @param path Where the JSON goes, - for stdout, or NULL to print a summary instead
+/// @param msg Where the summary goes
+/// @return False if the JSON couldn't be written
+bool stats_report(const struct stats * const s, const char * const path, FILE * const msg){
+    if(!s->enabled){ return true; }
+    if(NULL == path){
+        stats_print(s, &sort_counts, msg);
+        return true;
+    }
+    
+    FILE *out = 0 == strcmp(path, "-") ? stdout : fopen(path, "w");
+    if(NULL == out){
+        fprintf(stderr, "Couldn't open %s for the stats\n", path);
+        return false;
+    }
+    stats_write_json(s, &sort_counts, out);
+    if(out != stdout){ fclose(out); }
+    return true;
+}
 
-void    all_sort(uint32_t arr[], const int n, bool (*test)(uint32_t, uint32_t), gif_cb cb);
+/// Record that a frame would have been written, instead of writing one
+/// @param arr The array
+/// @param n The length of the array
+void gif_pix_array_write_trace(const uint32_t arr[], const int n){
+    trace_frame(trace_out);
+    cli_stats.frames++;
+}
 
-/// Write the new array to a gif frame
+/// Write the array as one row of the PPM, so the file ends up with a row per frame
 /// @param arr The array to put in
 /// @param n The length of the array
-void gif_pix_array_write(const uint32_t arr[], const int n){
-
-    assert(n == numbers);
-    
-    for(int item = 0; item < n; item++ ){
-        union pixel_t p;
-        p.rgbeol = arr[item];
-        p.eol = 0;
-        for(int r = 0; r < height; r++){
-            gif[(r*numbers) + item] = p;
-        }
-    }
-    gif_write_frame(&writer, (uint8_t*)gif, 8, false);
+void ppm_pix_array_write_frame(const uint32_t arr[], const int n){
+    stats_begin(&cli_stats, STATS_ENCODE);
+    ppm_pix_array_write(arr, n, &row_ppm);
+    stats_end(&cli_stats, STATS_ENCODE);
+    cli_stats.frames++;
 }
 
-/// A sorting algo
-struct sorter{
-    char name[PPM_FILEPATH_BUFF_LEN]; ///< The description used at the command line
-    void (*perform)(uint32_t arr[], const int n, bool (*test)(uint32_t, uint32_t), gif_cb cb); ///< The actual sort function
-};
+/// Does nothing, used to count frames
+/// @param arr The array
+/// @param n The length of the array
+void frame_skip(const uint32_t arr[], const int n){
+}
 
-/// The available sorting functions
-struct sorter sorters[] = {
-    { "merge", merge_sort_wrapper },
-    { "bubble", bubble_sort },
-    { "selection", selctn_sort },
-    { "heap", heap_sort },
-    { "radix", radix_sort },
-    { "all", all_sort },
-};
+/// Sort one batch job into its own Gif. This runs on a batch worker, so the sort globals
+/// it uses are that thread's own, and so is the render the job gets.
+/// @param job The job
+/// @param ctx The batch_opts
+/// @return Whether the Gif was written
+bool batch_job_gif(struct batch_job * const job, void *ctx){
+    static const unsigned int default_radix_sort_delay = 70;
+    const struct batch_opts * const opts = ctx;
+    struct render job_render;
+    struct sink out;
+    char filename[PPM_FILEPATH_BUFF_LEN + sizeof(".gif")];
+    
+    snprintf(filename, sizeof(filename), "%s.gif", job->output);
+    sink_path(&out, filename);
+    
+    uint32_t *arr = alloc_aligned((size_t)job->numbers * sizeof(*arr));
+    if(NULL == arr){
+        fprintf(stderr, "Not enough memory for %d elements\n", job->numbers);
+        return false;
+    }
+    batch_fill(job, &opts->input, arr);
+    
+    // Each job's colours are its own, so whether they fit one palette is up to the job
+    struct render_opts how = opts->render;
+    how.sorter = job->sorter;
+    if(sorters[job->sorter].perform[SORT_ASCENDING] == &radix_sort && how.delay != 0){
+        how.delay = default_radix_sort_delay;
+    }
+    
+    const bool rc = render_sort(&job_render, arr, job->numbers, &how, &out);
+    if(!rc){
+        fprintf(stderr, "Couldn't write %s\n", filename);
+    }
+    free(arr);
+    return rc;
+}
 
 int main(int argc, char * const argv[]) {
     
     static const unsigned int default_delay = 10;
     static const unsigned int default_radix_sort_delay = 70;
+    static const int default_numbers = 250;
+    static const int default_height = 50;
     
     char            filename[PPM_FILEPATH_BUFF_LEN];
     char            *oval = NULL;
     int             chosen_sort = -1;
     int             c = 0;
     unsigned int    delay = 0;
+    bool            delta = false;
+    bool            indexed = false;
+    bool            pipelined = false;
+    bool            parallel = false;
+    int             threads = 0;
+    char            *record_path = NULL;
+    char            *replay_path = NULL;
+    unsigned long   every = 0;
+    bool            ppm_out = false;
+    bool            ppm_ascii = false;
+    enum ppm_sequence_t sequence = PPM_SEQ_NONE;
+    bool            video = false;
+    enum rawvid_format_t video_format = RAWVID_RGB;
+    FILE            *msg = stdout;
+    unsigned long   frames = 0;
+    int             numbers = default_numbers;
+    int             height = default_height;
+    int             radix_bits = RADIX_DEFAULT_BITS;
+    bool            show_stats = false;
+    char            *stats_path = NULL;
+    char            *batch_path = NULL;
+    int             concurrent = 0;
+    struct input_opts input = { .dist = INPUT_UNIFORM, .seed = INPUT_DEFAULT_SEED };
+    char            *input_path = NULL;
+    char            *extern_path = NULL;
+    size_t          extern_mb = EXTSORT_DEFAULT_MEM_MB;
+    
+    static const struct option long_opts[] = {
+        { "stats", optional_argument, NULL, 'v' },
+        { NULL, 0, NULL, 0 }
+    };
     
-    srand((unsigned int)time(NULL));
     opterr = 0;
     
     // ------- Parse input -------
-    while ((c = getopt (argc, argv, "o:s:hr")) != -1)
+    while ((c = getopt_long (argc, argv, "o:s:hrdptj:T:R:e:Pf:n:H:AQ:V:b:w:vB:c:x:D:i:X:M:", long_opts, NULL)) != -1)
     switch (c)
     {
         case 'h':
-            printf("Usage:\n\t-o\toutput filename without .gif\n"
+            printf("Usage:\n\t-o\toutput filename without .gif or .ppm, or - for stdout with -V\n"
                    "\t-s\tsort type: ");
-            for(int i = 0; i < sizeof(sorters)/sizeof(*sorters); i++){
+            for(int i = 0; i < sorter_count; i++){
                 printf("%s ", sorters[i].name);
             }
             printf("\n"
+                   "\t-n\tHow many elements to sort\n"
+                   "\t-x\tSeed for the array, 1 by default, so the same seed always sorts the same array\n"
+                   "\t-D\tHow the array starts out, name[:k]: ");
+            for(int i = 0; i < INPUT_DISTS; i++){
+                printf("%s ", input_dist_names[i]);
+            }
+            printf("\n"
+                   "\t-i\tSort the colours in this file, 0xRRGGBB each, instead of making an array\n"
+                   "\t-H\tHeight of the image in pixels\n"
                    "\t-r\tRepeat the Gif\n"
+                   "\t-d\tOnly write the part of each frame which changed\n"
+                   "\t-p\tUse one palette for the whole Gif instead of quantising each frame\n"
+                   "\t-t\tEncode on a separate thread while the sort carries on\n"
+                   "\t-j\tCompress frames on this many threads, 0 for one per core\n"
+                   "\t-f\tMake at most this many frames, spread evenly over the sort\n"
+                   "\t-T\tRecord the sort to this trace file instead of making a Gif\n"
+                   "\t-R\tRender this trace file instead of sorting\n"
+                   "\t-e\tWhen rendering a trace, make a frame every this many operations\n"
+                   "\t-P\tWhen rendering a trace, write a PPM with a row per frame instead of a Gif\n"
+                   "\t-Q\tWrite a PPM per frame instead of a Gif: files, or stream for one after another in one file\n"
+                   "\t-A\tWrite ASCII P3 PPMs rather than binary P6\n"
+                   "\t-V\tStream raw video instead of a Gif: rgb, row or y4m\n"
+                   "\t-b\tBits per radix sort digit, 8 by default\n"
+                   "\t-w\tSort on this many threads where the sort can, 0 for one per core\n"
+                   "\t-v\tPrint the counts and timings at the end, or --stats=file for them as JSON\n"
+                   "\t-B\tRun the jobs in this file, a line of sorter size seed output each, with -H -r -p -d -f\n"
+                   "\t-c\tRun this many batch jobs at once, 0 for one per core\n"
+                   "\t-X\tSort this file of 4 byte pixels in place, however big, showing -n of them spread across it\n"
+                   "\t-M\tMegabytes of memory -X sorts each run in, 64 by default\n"
                    "\t-h\tHelp menu\n");
             return 1;
             break;
         case 'o':
             oval = optarg;
             break;
+        case 'n':
+            numbers = atoi(optarg);
+            break;
+        case 'H':
+            height = atoi(optarg);
+            break;
         case 'r':
             delay = default_delay;
             break;
+        case 'd':
+            delta = true;
+            break;
+        case 'p':
+            indexed = true;
+            break;
+        case 't':
+            pipelined = true;
+            break;
+        case 'j':
+            parallel = true;
+            threads = atoi(optarg);
+            break;
+        case 'f':
+            frames = strtoul(optarg, NULL, 10);
+            break;
+        case 'T':
+            record_path = optarg;
+            break;
+        case 'R':
+            replay_path = optarg;
+            break;
+        case 'e':
+            every = strtoul(optarg, NULL, 10);
+            break;
+        case 'P':
+            ppm_out = true;
+            break;
+        case 'A':
+            ppm_ascii = true;
+            break;
+        case 'V':
+            video = true;
+            if(!rawvid_format_parse(optarg, &video_format)){
+                fprintf(stderr, "-V needs rgb, row or y4m, not %s\n", optarg);
+                return 1;
+            }
+            break;
+        case 'b':
+            radix_bits = atoi(optarg);
+            break;
+        case 'w':
+            sort_threads = atoi(optarg);
+            break;
+        case 'v':
+            if(NULL != optarg){ stats_path = optarg; }
+            else{ show_stats = true; }
+            break;
+        case 'B':
+            batch_path = optarg;
+            break;
+        case 'c':
+            concurrent = atoi(optarg);
+            break;
+        case 'x':
+            input.seed = strtoull(optarg, NULL, 0);
+            break;
+        case 'D':
+            if(!input_dist_parse(optarg, &input)){
+                fprintf(stderr, "%s isn't a distribution\n", optarg);
+                return 1;
+            }
+            break;
+        case 'i':
+            input_path = optarg;
+            break;
+        case 'X':
+            extern_path = optarg;
+            break;
+        case 'M':
+            extern_mb = strtoul(optarg, NULL, 10);
+            break;
+        case 'Q':
+            if(0 == strcmp(optarg, "files")){ sequence = PPM_SEQ_FILES; }
+            else if(0 == strcmp(optarg, "stream")){ sequence = PPM_SEQ_STREAM; }
+            else{
+                fprintf(stderr, "-Q needs files or stream, not %s\n", optarg);
+                return 1;
+            }
+            break;
         case 's':
-            for(int i = 0; i < sizeof(sorters)/sizeof(*sorters); i++){
+            for(int i = 0; i < sorter_count; i++){
                 if(0 == strcmp(optarg, sorters[i].name)){
                     chosen_sort = i;
                     break;
@@ -231,7 +321,7 @@ int main(int argc, char * const argv[]) {
             }
             break;
         case '?':
-            if (optopt == 'o' || optopt == 's'){
+            if (optopt == 'o' || optopt == 's' || optopt == 'j' || optopt == 'T' || optopt == 'R' || optopt == 'e' || optopt == 'f' || optopt == 'n' || optopt == 'H' || optopt == 'Q' || optopt == 'V' || optopt == 'b' || optopt == 'w' || optopt == 'B' || optopt == 'c' || optopt == 'x' || optopt == 'D' || optopt == 'i' || optopt == 'X' || optopt == 'M'){
                 fprintf (stderr, "Option -%c requires an argument to say which kind of sort.\n", optopt);
             }
             else{
@@ -242,320 +332,262 @@ int main(int argc, char * const argv[]) {
             abort();
     }
 	
+    // The file decides how many there are
+    uint32_t *loaded = NULL;
+    if(NULL != input_path){
+        if(NULL != replay_path || NULL != batch_path){
+            fprintf(stderr, "-i can't be used with -R or -B, they bring their own arrays\n");
+            return 1;
+        }
+        loaded = input_load(input_path, &numbers);
+        if(NULL == loaded){ return 1; }
+    }
+    
+    // Everything -X can't do is turned away before the file is opened
+    struct extsort external = { .fd = -1, };
+    if(NULL != extern_path){
+        if(NULL != replay_path || NULL != batch_path || NULL != record_path || NULL != input_path || ppm_out){
+            fprintf(stderr, "-X can't be used with -R, -B, -T, -i or -P\n");
+            return 1;
+        }
+        if(numbers < 2 || height < 1 || 0 == extern_mb){
+            fprintf(stderr, "-X needs at least 2 elements in view, 1 pixel of height and a megabyte to sort in\n");
+            return 1;
+        }
+    }
+    
+    if(numbers < 2 || height < 1){
+        fprintf(stderr, "Need at least 2 elements and 1 pixel of height\n");
+        return 1;
+    }
+    
+    // Every job brings its own array and output, the workers set up their own radix sorts
+    if(NULL != batch_path){
+        struct batch batch;
+        if(!batch_load(&batch, batch_path)){ return 1; }
+        const struct batch_opts opts = {
+            .render = { .format = RENDER_GIF, .height = height, .delay = delay, .indexed = indexed, .delta = delta, .frames = frames },
+            .input = input
+        };
+        fprintf(msg, "Running %d jobs\n", batch.count);
+        const int failed = batch_run(&batch, concurrent, radix_bits, sort_threads, batch_job_gif, (void *)&opts, msg);
+        batch_free(&batch);
+        if(failed > 0){
+            fprintf(stderr, "%d of the jobs failed\n", failed);
+            return 1;
+        }
+        fprintf(msg, "Complete\n");
+        return PPM_ERR_NONE;
+    }
+    
+    if(!radix_init(&radix_engine, radix_bits, sort_threads)){ return 1; }
+    
+    if(ppm_out && NULL == replay_path){
+        fprintf(stderr, "-P only works when rendering a trace with -R\n");
+        return 1;
+    }
+    
+    // The file is only ever seen through a view of -n elements spread across it
+    if(NULL != extern_path){
+        if(!extsort_open(&external, extern_path, numbers, extern_mb * 1024 * 1024)){ return 1; }
+        numbers = external.width;
+    }
+    
     // Extract filename passed in, or use default
-    if(NULL != oval){
-        strncpy(filename, oval, strlen(oval));
-        strncat(filename, ".gif", strlen(".gif"));
+    // A sequence of files uses it as the stem for each frame's name
+    static const char * const video_ext[] = { ".rgb", ".row", ".y4m" };
+    const char *ext = ppm_out || PPM_SEQ_STREAM == sequence ? ".ppm" : PPM_SEQ_FILES == sequence ? "" : ".gif";
+    if(video){
+        ext = video_ext[video_format];
+        if(NULL != oval && 0 == strcmp(oval, RAWVID_STDOUT)){
+            // The video is going down stdout, so everything else mustn't
+            ext = "";
+            msg = stderr;
+        }
+    }
+    snprintf(filename, sizeof(filename), "%s%s", NULL != oval ? oval : "default", ext);
+    
+    // If no sort specified at command line then do all of them, or merge the runs of a file
+    if(-1 == chosen_sort){ chosen_sort = NULL != extern_path ? 0 : sorter_count-1; }
+    
+    // When rendering a trace the array, and so its length, come from that
+    struct trace replay = { 0, };
+    if(NULL != replay_path){
+        if(!trace_open(&replay, replay_path)){ return 1; }
+        numbers = replay.n;
+    }
+    
+    uint32_t *arr = alloc_aligned((size_t)numbers * sizeof(*arr));
+    if(NULL == arr){
+        fprintf(stderr, "Not enough memory for %d elements\n", numbers);
+        extsort_close(&external);
+        return 1;
+    }
+    
+    if(NULL != replay_path){
+        memcpy(arr, replay.arr, (size_t)numbers * sizeof(*arr));
+    }
+    else if(NULL != extern_path){
+        memcpy(arr, external.view, (size_t)numbers * sizeof(*arr));
+        fprintf(msg, "Sorting the %zu elements in %s, %zu runs of up to %zu\n", external.n, extern_path, external.runs, external.run_len);
+    }
+    else if(NULL != loaded){
+        memcpy(arr, loaded, (size_t)numbers * sizeof(*arr));
+        free(loaded);
+        fprintf(msg, "Sorting the %d colours in %s\n", numbers, input_path);
     }
     else{
-        strncpy(filename, "default.gif", strlen("default.gif"));
+        input_fill(arr, numbers, &input);
+        fprintf(msg, "Sorting %d %s elements, seed %llu\n", numbers, input_dist_names[input.dist], (unsigned long long)input.seed);
     }
     
-    // If no sort specified at command line then do all of them
-    if(-1 == chosen_sort){ chosen_sort = sizeof(sorters)/sizeof(*sorters)-1; }
+    // Just record what the sort does, it can be rendered later with -R
+    if(NULL != record_path){
+        if(!trace_begin(&tracer, record_path, arr, numbers)){ return 1; }
+        trace_out = &tracer;
+        fprintf(msg, "Recording %s to %s\n", sorters[chosen_sort].name, record_path);
+        cli_stats.enabled = show_stats || NULL != stats_path;
+        stats_begin(&cli_stats, STATS_SORT);
+        sorters[chosen_sort].perform[SORT_ASCENDING_TRACED](arr, numbers, gif_pix_array_write_trace);
+        stats_end(&cli_stats, STATS_SORT);
+        trace_out = NULL;
+        free(arr);
+        radix_free(&radix_engine);
+        if(!trace_end(&tracer)){
+            fprintf(stderr, "Couldn't write all of %s\n", record_path);
+            return 1;
+        }
+        fprintf(msg, "Complete and written to %s\n", record_path);
+        return stats_report(&cli_stats, stats_path, msg) ? PPM_ERR_NONE : 1;
+    }
     
-	// Initialise array to a bunch of random values
-	uint32_t arr[numbers]= { 0, };
-    memset(gif, UINT32_MAX, numbers * height);
-	
-	for(int i = 0; i < numbers; i++){
-		arr[i] = random()%UINT32_MAX;
-        for(int r = 0; r < height; r++){
-            gif[(r*numbers) + i].rgbeol = arr[i];
+    // A PPM needs to know how many rows it'll have up front, so count the frames first
+    if(ppm_out){
+        const long frames = trace_replay(&replay, every, NULL, frame_skip);
+        trace_end(&replay);
+        if(frames < 0 || !trace_open(&replay, replay_path)){ return 1; }
+        
+        strncpy(row_ppm.file_name, filename, sizeof(row_ppm.file_name));
+        row_ppm.width = numbers;
+        row_ppm.height = (int)frames;
+        row_ppm.max = 255;
+        row_ppm.ascii = ppm_ascii;
+        if(PPM_ERR_NONE != ppm_init(&row_ppm)){
+            trace_end(&replay);
+            return 1;
         }
-	}
+        cli_stats.enabled = show_stats || NULL != stats_path;
+        stats_begin(&cli_stats, STATS_SORT);
+        trace_replay(&replay, every, NULL, ppm_pix_array_write_frame);
+        stats_end(&cli_stats, STATS_SORT);
+        trace_end(&replay);
+        free(arr);
+        if(PPM_ERR_NONE != ppm_deinit(&row_ppm)){
+            fprintf(stderr, "Couldn't finish writing %s\n", filename);
+            return 1;
+        }
+        fprintf(msg, "Complete and written to %s\n", filename);
+        return stats_report(&cli_stats, stats_path, msg) ? PPM_ERR_NONE : 1;
+    }
+    
+    // Racing the sorts stacks a strip per sort in every frame
+    const int lanes = NULL == replay_path && NULL == extern_path ? sort_lanes(chosen_sort) : 1;
+    
+    // Gif sizes are 16 bit
+    if(PPM_SEQ_NONE == sequence && !video && (numbers > UINT16_MAX || (long)height * lanes > UINT16_MAX)){
+        fprintf(stderr, "A Gif can't be more than %d pixels either way, use -T to sort this many\n", UINT16_MAX);
+        extsort_close(&external);
+        return 1;
+    }
     
     // The radix sort needs a longer delay because it's got so few steps
-    if(sorters[chosen_sort].perform == &radix_sort && delay != 0){
+    if(sorters[chosen_sort].perform[SORT_ASCENDING] == &radix_sort && delay != 0 && NULL == replay_path && NULL == extern_path){
         delay = default_radix_sort_delay;
-        printf("Setting radix sort delay to %dms\n", delay * 10);
+        fprintf(msg, "Setting radix sort delay to %dms\n", delay * 10);
     }
     
-    printf("Delay is %dms\n", delay * 10);
-
-    writer.delay = delay;
-    writer.size.width = numbers;
-    writer.size.height = height;
+    fprintf(msg, "Delay is %dms\n", delay * 10);
     
-    bool rc = gif_begin(&writer, filename);
-    if(!rc){
-        fprintf(stderr, "Unsuccessful gif_begin\n");
-        return 0;
+    if((indexed || delta || parallel) && PPM_SEQ_NONE == sequence && !video && NULL != extern_path){
+        fprintf(stderr, "The view of a file shows colours from all over it, so it can't use one palette\n");
+        indexed = delta = parallel = false;
+    }
+    
+    // Only a sort run here has counts for the frame budget and the repeats to go by.
+    // -e does the budget's job when rendering a trace, and -f goes to the merge of a file.
+    const struct render_opts how = {
+        .format = PPM_SEQ_FILES == sequence ? RENDER_PPM_FILES : PPM_SEQ_STREAM == sequence ? RENDER_PPM_STREAM : video ? RENDER_VIDEO : RENDER_GIF,
+        .sorter = NULL == replay_path && NULL == extern_path ? chosen_sort : -1,
+        .height = height,
+        .delay = delay,
+        .indexed = indexed,
+        .delta = delta,
+        .parallel = parallel,
+        .threads = threads,
+        .pipelined = pipelined,
+        .frames = frames,
+        .ascii = ppm_ascii,
+        .video = video_format,
+        .stats = show_stats || NULL != stats_path,
+    };
+    struct sink out;
+    if(video && 0 == strcmp(filename, RAWVID_STDOUT)){ sink_fd(&out, STDOUT_FILENO); }
+    else{ sink_path(&out, filename); }
+    
+    struct render * const render = &main_render;
+    if(!render_begin(render, arr, numbers, lanes, &how, &out)){
+        extsort_close(&external);
+        return 1;
+    }
+    if(render->idx_pool.threads){
+        fprintf(msg, "Compressing on %d threads\n", render->idx_pool.threads);
+    }
+    if(render->budget_frames){
+        fprintf(msg, "Spreading %lu frames over %lu operations\n", render->budget_frames, render->budget_ops);
     }
     //-------------------------
-
-	printf("Now sorting as %s\n", sorters[chosen_sort].name);
     
-    bool (*order)(uint32_t, uint32_t) = gt_than;
-    gif_pix_array_write(arr, numbers);
-    sorters[chosen_sort].perform(arr, numbers, order, gif_pix_array_write);
+    bool rc = true;
+    if(NULL != replay_path){
+        fprintf(msg, "Now rendering %s\n", replay_path);
+        
+        // Picks up the palette tags, and the values written back in need them too
+        memcpy(replay.arr, arr, (size_t)numbers * sizeof(*arr));
+        stats_begin(&render->stats, STATS_SORT);
+        trace_replay(&replay, every, render->indexed ? render_tag : NULL, render->frame);
+        stats_end(&render->stats, STATS_SORT);
+        trace_end(&replay);
+    }
+    else if(NULL != extern_path){
+        fprintf(msg, "Now sorting the runs as %s then merging them\n", sorters[chosen_sort].name);
+        
+        stats_begin(&render->stats, STATS_SORT);
+        render->frame(arr, numbers);
+        rc = extsort_sort(&external, sorters[chosen_sort].perform[SORT_ASCENDING], frames > 0 ? frames : EXTSORT_MERGE_FRAMES, render->frame);
+        stats_end(&render->stats, STATS_SORT);
+        extsort_close(&external);
+        if(!rc){ fprintf(stderr, "Couldn't sort all of %s\n", extern_path); }
+    }
+    else{
+        fprintf(msg, "Now sorting as %s\n", sorters[chosen_sort].name);
+        
+        const enum sort_order order = SORT_ASCENDING;
+        stats_begin(&render->stats, STATS_SORT);
+        // The race puts its own starting line out
+        if(1 == lanes){ render->frame(arr, numbers); }
+        sorters[chosen_sort].perform[order](arr, numbers, render->frame);
+        stats_end(&render->stats, STATS_SORT);
+    }
     
 	// Cleanup
-    gif_end(&writer);
-	printf("Complete and written to %s\n", filename);
-	
-	return PPM_ERR_NONE;
-}
-
-//-----------------------------------------------------
-
-void merge_sort_wrapper(uint32_t arr[], int n, bool (*test)(uint32_t, uint32_t), gif_cb cb){
-    merge_sort (arr, 0, n-1, test, gif_pix_array_write, n);
-}
-
-//-----------------------------------------------------
-void all_sort(uint32_t arr[], const int n, bool (*test)(uint32_t, uint32_t), gif_cb cb){
-    uint32_t other_arr[n];
-    memcpy(other_arr, arr, n);
-    
-    for(int i = 0; i < (sizeof(sorters)/sizeof(*sorters))-2; i++){
-        sorters[i].perform(arr, n, test, cb);
-        memcpy(arr, other_arr, n);
+    if(!render_end(render)){
+        fprintf(stderr, "Couldn't write all of %s\n", filename);
+        rc = false;
     }
-}
-
-//-----------------------------------------------------
-uint32_t get_max_average(uint32_t arr[], int n)
-{
-	uint32_t mx = ppm_pix_get_average((union pixel_t)arr[0]);
-	for (int i = 1; i < n; i++){
-		if (ppm_pix_get_average((union pixel_t)arr[i]) > mx){
-			mx = ppm_pix_get_average((union pixel_t)arr[i]);
-		}
-	}
-	return mx;
-}
-
-//-----------------------------------------------------
-void count_sort(uint32_t arr[], const int n, const int exp, gif_cb cb){
-    uint32_t output[n]; // output array
-	int64_t i, count[10] = {0};
-    
-	// Store count of occurrences in count[]
-	for (i = 0; i < n; i++){
-		count[ (ppm_pix_get_average((union pixel_t)arr[i])/exp)%10 ]++;
-	}
-	// Change count[i] so that count[i] now contains actual
-	//  position of this digit in output[]
-	for (i = 1; i < 10; i++){
-		count[i] += count[i - 1];
-	}
-	
-	// Build the output array
-	for (i = n - 1; i >= 0; i--)
-	{
-		output[count[ (ppm_pix_get_average((union pixel_t)arr[i])/exp)%10 ] - 1] = arr[i];
-		count[ (ppm_pix_get_average((union pixel_t)arr[i])/exp)%10 ]--;
-		//if(cb != NULL) { cb(output, n); }
-	}
- 
-	// Copy the output array to arr[], so that arr[] now
-	// contains sorted numbers according to current digit
-	for (i = 0; i < n; i++)
-		arr[i] = output[i];
-}
-
-//-----------------------------------------------------
-void radix_sort(uint32_t arr[], const int n, bool (*test)(uint32_t, uint32_t), gif_cb cb)
-{
-    (void)test;
-    if(cb != NULL) { cb(arr, n); }
-
-	// Find the maximum number to know number of digits
-	uint32_t m = get_max_average(arr, n);
- 
-	// Do counting sort for every digit. Note that instead
-	// of passing digit number, exp is passed. exp is 10^i
-	// where i is current digit number
-	for (uint32_t exp = 1; m/exp > 0; exp *= 10){
-		count_sort(arr, n, exp, cb);
-		if(cb != NULL) { cb(arr, n); }
-	}
-
-}
-
-
-
-//-----------------------------------------------------
-void swap(uint32_t * const xp, uint32_t * const yp){
-	uint32_t temp = *xp;
-	*xp = *yp;
-	*yp = temp;
-}
-
-//-----------------------------------------------------
-bool gt_than(const uint32_t a, const uint32_t b){
-	return a > b;
-}
-
-//-----------------------------------------------------
-bool less_than(const uint32_t a, const uint32_t b){
-	return a < b;
-}
-
-//-----------------------------------------------------
-void bubble_sort(uint32_t arr[], int n, bool (*test)(uint32_t, uint32_t), gif_cb cb){
-	int i, j;
-	for (i = 0; i < n-1; i++){
-		
-		// Last i elements are already in place
-		for (j = 0; j < n-i-1; j++){
-			if (test(ppm_pix_get_average((union pixel_t)arr[j]), ppm_pix_get_average((union pixel_t)arr[j+1])))
-			{
-				swap(&arr[j], &arr[j+1]);
-			}
-		}
-        if(cb != NULL) { cb(arr, n); }
-	}
-}
-
-//-----------------------------------------------------
-uint32_t ppm_pix_get_average(const union pixel_t p){
-	return (p.r+p.g+p.g)/3;
-}
-
-//-----------------------------------------------------
-void selctn_sort(uint32_t arr[], int n, bool (*test)(uint32_t, uint32_t), gif_cb cb) {
-	int i, j, minIndex, tmp;
-	for (i = 0; i < n - 1; i++) {
-		minIndex = i;
-		for (j = i + 1; j < n; j++)
-			if(!test(ppm_pix_get_average((union pixel_t)arr[j]), ppm_pix_get_average((union pixel_t)arr[minIndex])))
-				minIndex = j;
-		if (minIndex != i) {
-			tmp = arr[i];
-			arr[i] = arr[minIndex];
-			arr[minIndex] = tmp;
-		}
-        if(cb != NULL) { cb(arr, n); }
-	}
-    if(cb != NULL) { cb(arr, n); }
-}
-
-//-----------------------------------------------------
-void heapify(uint32_t arr[], int n, const int i, bool (*test)(uint32_t, uint32_t)){
+    radix_free(&radix_engine);
+    free(arr);
+    if(!rc){ return 1; }
+	fprintf(msg, "Complete and written to %s\n", filename);
 	
-	assert(test);
-	int smallest = i;  // Initialize largest as root
-	int l = 2*i + 1;  // left = 2*i + 1
-	int r = 2*i + 2;  // right = 2*i + 2
- 
-	// If left child is smaller than root
-	if (l < n && test(ppm_pix_get_average((union pixel_t)arr[l]), ppm_pix_get_average((union pixel_t)arr[smallest])))
-		smallest = l;
- 
-	// If right child is smaller than the smallest so far
-	if (r < n && test(ppm_pix_get_average((union pixel_t)arr[r]), ppm_pix_get_average((union pixel_t)arr[smallest])))
-		smallest = r;
- 
-	// If largest is not root
-	if (smallest != i)
-	{
-		swap(&arr[i], &arr[smallest]);
-		
-		// Recursively heapify the affected sub-tree
-		heapify(arr, n, smallest, test);
-	}
+	return stats_report(&render->stats, stats_path, msg) ? PPM_ERR_NONE : 1;
 }
-
-//-----------------------------------------------------
-void heap_sort(uint32_t arr[], int n, bool (*test)(uint32_t, uint32_t), gif_cb cb)
-{
-	
-	assert(test);
-	// Build heap (rearrange array)
-	for (int i = n / 2 - 1; i >= 0; i--){
-		heapify(arr, n, i, test);
-        if(cb != NULL) { cb(arr, n); }
-	}
- 
-	// One by one extract an element from heap
-	for (int i=n-1; i>=0; i--)
-	{
-		// Move current root to end
-		swap(&arr[0], &arr[i]);
-		
-		// call max heapify on the reduced heap
-		heapify(arr, i, 0, test);
-		
-        if(cb != NULL) { cb(arr, n); }
-	}
-}
-
-//-----------------------------------------------------
-void merge(uint32_t arr[], int l, int m, int r, bool (*test)(uint32_t, uint32_t)){
-	
-	assert(test);
-	uint32_t i, j, k;
-	uint32_t n1 = m - l + 1;
-	uint32_t n2 =  r - m;
- 
-	/* create temp arrays */
-	uint32_t L[n1], R[n2];
- 
-	/* Copy data to temp arrays L[] and R[] */
-	for (i = 0; i < n1; i++)
-		L[i] = arr[l + i];
-	for (j = 0; j < n2; j++)
-		R[j] = arr[m + 1+ j];
- 
-	/* Merge the temp arrays back into arr[l..r]*/
-	i = 0; // Initial index of first subarray
-	j = 0; // Initial index of second subarray
-	k = l; // Initial index of merged subarray
-	while (i < n1 && j < n2)
-	{
-		if (!test(ppm_pix_get_average((union pixel_t)L[i]), ppm_pix_get_average((union pixel_t)R[j])))
-		{
-			arr[k] = L[i];
-			i++;
-		}
-		else
-		{
-			arr[k] = R[j];
-			j++;
-		}
-		k++;
-	}
- 
-	/* Copy the remaining elements of L[], if there
-	 are any */
-	while (i < n1)
-	{
-		arr[k] = L[i];
-		i++;
-		k++;
-	}
- 
-	/* Copy the remaining elements of R[], if there
-	 are any */
-	while (j < n2)
-	{
-		arr[k] = R[j];
-		j++;
-		k++;
-	}
-}
-
-//-----------------------------------------------------
-void merge_sort(uint32_t arr[], int l, int r, bool (*test)(uint32_t, uint32_t), gif_cb cb, const int arr_len){
-	
-	assert(test);
-    
-	if (l < r)
-	{
-		// Same as (l+r)/2, but avoids overflow for
-		// large l and h
-		int m = l+(r-l)/2;
-		
-		// Sort first and second halves
-		merge_sort(arr, l, m, test, cb, arr_len);
-		merge_sort(arr, m+1, r,test,cb, arr_len);
-		merge(arr, l, m, r, test);
-        if(cb != NULL) { cb(arr, arr_len); }
-
-	}
-	
-}
-
-
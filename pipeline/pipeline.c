@@ -0,0 +1,113 @@
+//
+//  pipeline.c
+//  Visualiser
+//
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <assert.h>
+
+#include "pipeline.h"
+
+static _Thread_local void *pipeline_self = NULL;	///< The ctx of the pipeline this thread drains
+
+//-----------------------------------------------------
+static void *pipeline_run(void *arg){
+	struct pipeline * const p = arg;
+
+	pipeline_self = p->ctx;
+	pthread_mutex_lock(&p->lock);
+	for(;;){
+		while(p->count == 0 && !p->done){
+			pthread_cond_wait(&p->not_empty, &p->lock);
+		}
+		if(p->count == 0){ break; }
+
+		// The producer won't touch this slot until count goes down, so write it unlocked
+		const uint32_t *frame = &p->slots[(size_t)p->tail * p->n];
+		pthread_mutex_unlock(&p->lock);
+		p->sink(frame, p->n);
+		pthread_mutex_lock(&p->lock);
+
+		p->tail = (p->tail + 1) % p->capacity;
+		p->count--;
+		pthread_cond_signal(&p->not_full);
+	}
+	pthread_mutex_unlock(&p->lock);
+	return NULL;
+}
+
+//-----------------------------------------------------
+bool pipeline_start(struct pipeline * const p, const int capacity, const int n, pipeline_sink sink, void *ctx){
+
+	assert(capacity > 0);
+	memset(p, 0, sizeof(*p));
+	p->slots = malloc((size_t)capacity * n * sizeof(*p->slots));
+	if(!p->slots){
+		fprintf(stderr, "[%d] Out of memory for %d frames\n", __LINE__, capacity);
+		return false;
+	}
+	p->n = n;
+	p->capacity = capacity;
+	p->sink = sink;
+	p->ctx = ctx;
+
+	pthread_mutex_init(&p->lock, NULL);
+	pthread_cond_init(&p->not_empty, NULL);
+	pthread_cond_init(&p->not_full, NULL);
+
+	if(0 != pthread_create(&p->thread, NULL, pipeline_run, p)){
+		fprintf(stderr, "[%d] Couldn't start the encoder thread\n", __LINE__);
+		free(p->slots);
+		p->slots = NULL;
+		return false;
+	}
+	return true;
+}
+
+//-----------------------------------------------------
+void pipeline_push(struct pipeline * const p, const uint32_t arr[], const int n){
+
+	assert(n == p->n);
+
+	pthread_mutex_lock(&p->lock);
+	while(p->count == p->capacity){
+		pthread_cond_wait(&p->not_full, &p->lock);
+	}
+	uint32_t *slot = &p->slots[(size_t)p->head * p->n];
+	pthread_mutex_unlock(&p->lock);
+
+	// The encoder won't read this slot until count goes up
+	memcpy(slot, arr, (size_t)n * sizeof(*arr));
+
+	pthread_mutex_lock(&p->lock);
+	p->head = (p->head + 1) % p->capacity;
+	p->count++;
+	pthread_cond_signal(&p->not_empty);
+	pthread_mutex_unlock(&p->lock);
+}
+
+//-----------------------------------------------------
+void pipeline_finish(struct pipeline * const p){
+
+	if(!p->slots){ return; }
+
+	pthread_mutex_lock(&p->lock);
+	p->done = true;
+	pthread_cond_signal(&p->not_empty);
+	pthread_mutex_unlock(&p->lock);
+
+	pthread_join(p->thread, NULL);
+
+	pthread_cond_destroy(&p->not_full);
+	pthread_cond_destroy(&p->not_empty);
+	pthread_mutex_destroy(&p->lock);
+	free(p->slots);
+	p->slots = NULL;
+}
+
+//-----------------------------------------------------
+void *pipeline_ctx(void){
+	return pipeline_self;
+}
@@ -0,0 +1,77 @@
+//
+//  pipeline.h
+//  Visualiser
+//
+//  Decouples the sort from the encoder. The sort pushes copies of the array into a
+//  bounded ring of slots and carries on, while a separate thread takes them off
+//  in order and hands them to the real frame writer.
+//
+
+#ifndef pipeline_h
+#define pipeline_h
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <pthread.h>
+
+#define PIPELINE_DEFAULT_SLOTS				64
+
+/// The function which actually writes a frame, same shape as the gif callback
+typedef void (*pipeline_sink)(const uint32_t arr[], const int n);
+
+/**
+ The ring of frame snapshots and the thread draining it
+ */
+struct pipeline{
+	uint32_t		*slots;			///< capacity * n elements
+	int				n;				///< Length of each snapshot
+	int				capacity;		///< Number of slots
+	int				head;			///< Next slot to fill
+	int				tail;			///< Next slot to write out
+	int				count;			///< Slots waiting to be written
+	bool			done;			///< No more frames are coming
+	pipeline_sink	sink;
+	void			*ctx;			///< Whatever the sink needs, see pipeline_ctx
+	pthread_t		thread;
+	pthread_mutex_t	lock;
+	pthread_cond_t	not_empty;
+	pthread_cond_t	not_full;
+};
+
+//-----------------------------------------------------
+/**
+ Allocate the ring and start the encoder thread
+
+ @param p The pipeline
+ @param capacity How many frames can be waiting at once
+ @param n The length of the array in each frame
+ @param sink Where the frames end up
+ @param ctx What pipeline_ctx gives the sink, since it only gets the array
+ @return Success or not
+ */
+bool	pipeline_start(struct pipeline * const p, const int capacity, const int n, pipeline_sink sink, void *ctx);
+
+/**
+ Copy a frame into the ring. Only blocks if the ring is full.
+
+ @param p The pipeline
+ @param arr The array
+ @param n The length of it
+ */
+void	pipeline_push(struct pipeline * const p, const uint32_t arr[], const int n);
+
+/**
+ Wait for every frame to be written, then stop the thread and free the ring
+
+ @param p The pipeline
+ */
+void	pipeline_finish(struct pipeline * const p);
+
+/**
+ The ctx of the pipeline whose thread this is, for the sink to find its way back
+
+ @return The ctx given to pipeline_start, or NULL if this isn't an encoder thread
+ */
+void	*pipeline_ctx(void);
+
+#endif /* pipeline_h */
@@ -0,0 +1,251 @@
+//
+//  pmerge.c
+//  Visualiser
+//
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+#include <unistd.h>
+
+#include "pmerge.h"
+
+struct pmerge;
+
+/// A merging thread and what it did this level
+struct pmerge_worker{
+	struct pmerge	*pm;
+	int				id;
+	unsigned long	compares;
+	unsigned long	writes;
+	pthread_t		thread;
+};
+
+/**
+ What every thread shares. The caller bumps level to start one, and waits for
+ pending to get back to 0 before looking at the array.
+ */
+struct pmerge{
+	const uint32_t			*src;
+	const uint32_t			*src_key;
+	uint32_t				*dst;
+	uint32_t				*dst_key;
+	int						n;
+	int						width;			///< Length of the runs being merged this level
+	bool					descending;
+	int						threads;
+	struct pmerge_worker	*worker;
+	unsigned long			level;			///< Goes up once per level
+	int						pending;		///< Threads still working on this level
+	bool					done;
+	pthread_mutex_t			lock;
+	pthread_cond_t			start;
+	pthread_cond_t			finished;
+};
+
+//-----------------------------------------------------
+/// Whether a belongs strictly before b
+static inline bool pmerge_before(const uint32_t a, const uint32_t b, const bool descending){
+	return descending ? a > b : a < b;
+}
+
+//-----------------------------------------------------
+/// How many of the first k outputs of merging a and b come from a. Ties go to a.
+static int pmerge_co_rank(const int k, const uint32_t a[], const int m, const uint32_t b[], const int l, const bool descending, unsigned long * const compares){
+	int lo = k > l ? k - l : 0;
+	int hi = k < m ? k : m;
+	for(;;){
+		const int i = lo + (hi - lo) / 2;
+		const int j = k - i;
+		(*compares)++;
+		if(i > 0 && j < l && pmerge_before(b[j], a[i - 1], descending)){
+			hi = i - 1;
+		}
+		else if(j > 0 && i < m && !pmerge_before(b[j - 1], a[i], descending)){
+			lo = i + 1;
+		}
+		else{
+			return i;
+		}
+	}
+}
+
+//-----------------------------------------------------
+/// Fill the outputs [lo, hi) of the current level
+static void pmerge_slice(struct pmerge * const pm, int lo, const int hi, struct pmerge_worker * const w){
+	const int width = pm->width;
+	const bool desc = pm->descending;
+
+	while(lo < hi){
+		// The pair of runs this output falls in
+		const int start = (lo / (2 * width)) * 2 * width;
+		const int mid = start + width < pm->n ? start + width : pm->n;
+		const int end = start + 2 * width < pm->n ? start + 2 * width : pm->n;
+		const int stop = hi < end ? hi : end;
+
+		const uint32_t * const a = &pm->src_key[start];
+		const uint32_t * const b = &pm->src_key[mid];
+		const int m = mid - start, l = end - mid;
+
+		int i = pmerge_co_rank(lo - start, a, m, b, l, desc, &w->compares);
+		int j = lo - start - i;
+		for(int k = lo; k < stop; k++){
+			w->compares += i < m && j < l;
+			if(j < l && (i == m || pmerge_before(b[j], a[i], desc))){
+				pm->dst[k] = pm->src[mid + j];
+				pm->dst_key[k] = b[j];
+				j++;
+			}
+			else{
+				pm->dst[k] = pm->src[start + i];
+				pm->dst_key[k] = a[i];
+				i++;
+			}
+		}
+		w->writes += (unsigned long)(stop - lo);
+		lo = stop;
+	}
+}
+
+//-----------------------------------------------------
+/// Where thread t's share of each level starts
+static inline int pmerge_share_start(const struct pmerge * const pm, const int t){
+	return (int)((long)pm->n * t / pm->threads);
+}
+
+//-----------------------------------------------------
+/// Do this thread's share of the level
+static void pmerge_share(struct pmerge * const pm, struct pmerge_worker * const w){
+	w->compares = w->writes = 0;
+	pmerge_slice(pm, pmerge_share_start(pm, w->id), pmerge_share_start(pm, w->id + 1), w);
+}
+
+//-----------------------------------------------------
+static void *pmerge_run(void *arg){
+	struct pmerge_worker * const w = arg;
+	struct pmerge * const pm = w->pm;
+	unsigned long seen = 0;
+
+	pthread_mutex_lock(&pm->lock);
+	for(;;){
+		while(pm->level == seen && !pm->done){
+			pthread_cond_wait(&pm->start, &pm->lock);
+		}
+		if(pm->done){ break; }
+		seen = pm->level;
+		pthread_mutex_unlock(&pm->lock);
+
+		pmerge_share(pm, w);
+
+		pthread_mutex_lock(&pm->lock);
+		if(--pm->pending == 0){ pthread_cond_signal(&pm->finished); }
+	}
+	pthread_mutex_unlock(&pm->lock);
+	return NULL;
+}
+
+//-----------------------------------------------------
+bool pmerge_sort(uint32_t arr[], uint32_t key[], const int n, int threads, const bool descending, const bool shown, pmerge_level_cb cb, void *ctx){
+
+	if(n < 2){ return true; }
+
+	if(threads <= 0){
+		threads = (int)sysconf(_SC_NPROCESSORS_ONLN);
+	}
+	const int min_len = shown ? PMERGE_SHOWN_MIN_LEN : PMERGE_THREAD_MIN_LEN;
+	if(threads > n / min_len){ threads = n / min_len; }
+	if(threads < 1){ threads = 1; }
+
+	struct pmerge pm = { .n = n, .descending = descending, .threads = threads };
+	// Showing the slices one at a time needs a view of the array, and keys for it
+	uint32_t * const buf = malloc((size_t)n * (shown ? 4 : 2) * sizeof(*buf));
+	pm.worker = calloc(threads, sizeof(*pm.worker));
+	if(!buf || !pm.worker){
+		fprintf(stderr, "[%d] Out of memory to merge %d elements on %d threads\n", __LINE__, n, threads);
+		free(buf);
+		free(pm.worker);
+		return false;
+	}
+	uint32_t * const buf_key = buf + n;
+	uint32_t * const view = shown ? buf + 2 * n : NULL;
+	uint32_t * const view_key = shown ? buf + 3 * n : NULL;
+
+	pthread_mutex_init(&pm.lock, NULL);
+	pthread_cond_init(&pm.start, NULL);
+	pthread_cond_init(&pm.finished, NULL);
+
+	// The caller is worker 0, if a thread doesn't start the ones after it are dropped
+	for(int t = 0; t < threads; t++){
+		pm.worker[t].pm = &pm;
+		pm.worker[t].id = t;
+	}
+	int started = 1;
+	for(; started < threads; started++){
+		if(0 != pthread_create(&pm.worker[started].thread, NULL, pmerge_run, &pm.worker[started])){ break; }
+	}
+	pm.threads = started;
+
+	uint32_t *src = arr, *src_key = key, *dst = buf, *dst_key = buf_key;
+	for(int width = 1; width < n; width *= 2){
+		pthread_mutex_lock(&pm.lock);
+		pm.src = src;
+		pm.src_key = src_key;
+		pm.dst = dst;
+		pm.dst_key = dst_key;
+		pm.width = width;
+		pm.pending = pm.threads - 1;
+		pm.level++;
+		pthread_cond_broadcast(&pm.start);
+		pthread_mutex_unlock(&pm.lock);
+
+		pmerge_share(&pm, &pm.worker[0]);
+
+		pthread_mutex_lock(&pm.lock);
+		while(pm.pending > 0){
+			pthread_cond_wait(&pm.finished, &pm.lock);
+		}
+		pthread_mutex_unlock(&pm.lock);
+
+		if(cb && !shown){
+			unsigned long compares = 0, writes = 0;
+			for(int t = 0; t < pm.threads; t++){
+				compares += pm.worker[t].compares;
+				writes += pm.worker[t].writes;
+			}
+			cb(dst, dst_key, n, 0, n, compares, writes, ctx);
+		}
+		else if(cb){
+			// Each slice over the level before, in turn, so the frames show who merged what
+			memcpy(view, src, (size_t)n * sizeof(*view));
+			memcpy(view_key, src_key, (size_t)n * sizeof(*view_key));
+			for(int t = 0; t < pm.threads; t++){
+				const int lo = pmerge_share_start(&pm, t), hi = pmerge_share_start(&pm, t + 1);
+				memcpy(&view[lo], &dst[lo], (size_t)(hi - lo) * sizeof(*view));
+				memcpy(&view_key[lo], &dst_key[lo], (size_t)(hi - lo) * sizeof(*view_key));
+				cb(view, view_key, n, lo, hi, pm.worker[t].compares, pm.worker[t].writes, ctx);
+			}
+		}
+
+		uint32_t *tmp = src; src = dst; dst = tmp;
+		tmp = src_key; src_key = dst_key; dst_key = tmp;
+	}
+
+	pthread_mutex_lock(&pm.lock);
+	pm.done = true;
+	pthread_cond_broadcast(&pm.start);
+	pthread_mutex_unlock(&pm.lock);
+	for(int t = 1; t < pm.threads; t++){ pthread_join(pm.worker[t].thread, NULL); }
+
+	if(src != arr){
+		memcpy(arr, src, (size_t)n * sizeof(*arr));
+		memcpy(key, src_key, (size_t)n * sizeof(*key));
+	}
+
+	pthread_cond_destroy(&pm.finished);
+	pthread_cond_destroy(&pm.start);
+	pthread_mutex_destroy(&pm.lock);
+	free(pm.worker);
+	free(buf);
+	return true;
+}
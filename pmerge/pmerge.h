@@ -0,0 +1,57 @@
+//
+//  pmerge.h
+//  Visualiser
+//
+//  A bottom-up merge sort which does each level on several threads. Rather than
+//  giving each thread whole merges, which leaves all but one idle at the top, the
+//  level's output is cut into equal slices and each thread finds where its slice
+//  starts in the two runs by binary search. Every thread finishes a level before
+//  any starts the next, so the array is whole between levels.
+//
+//  When the levels are being shown, each one is shown a slice at a time, in the
+//  order of the threads which merged them. The slices not done yet are as they
+//  were after the level before, so every frame shows each slice as a whole, and
+//  the last of a level is the whole array.
+//
+
+#ifndef pmerge_h
+#define pmerge_h
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#define PMERGE_THREAD_MIN_LEN				4096		///< Fewer elements than this each and a thread isn't worth waking
+#define PMERGE_SHOWN_MIN_LEN				4			///< Unless the levels are being shown, then it's worth it to see the split
+
+/**
+ Called between levels from the thread which called pmerge_sort, once for each thread's
+ slice if the levels are being shown, otherwise once for the whole level
+
+ @param arr The array with the slices up to this one after the level, and the rest before it
+ @param key The keys that go with it
+ @param n The length of both
+ @param lo Where the slice starts
+ @param hi And where it ends, one past
+ @param compares The compares the slice took
+ @param writes The elements it wrote, which is always hi - lo
+ @param ctx Whatever was given to pmerge_sort
+ */
+typedef void (*pmerge_level_cb)(const uint32_t arr[], const uint32_t key[], const int n, const int lo, const int hi, const unsigned long compares, const unsigned long writes, void *ctx);
+
+//-----------------------------------------------------
+/**
+ Stable sort the array by its keys, moving both
+
+ @param arr The payload
+ @param key The keys, in step with arr
+ @param n The length of both
+ @param threads How many threads to merge on, 0 for one per core
+ @param descending Largest key first rather than smallest
+ @param shown Whether the levels are being shown, so they're split between threads however short
+ @param cb Called after every level, may be NULL
+ @param ctx Given to cb
+ @return False if it couldn't get the memory, in which case nothing moved
+ */
+bool	pmerge_sort(uint32_t arr[], uint32_t key[], const int n, int threads, const bool descending, const bool shown, pmerge_level_cb cb, void *ctx);
+
+#endif /* pmerge_h */
@@ -3,12 +3,41 @@
 //  Visualiser
 //
 
+#include <string.h>
+
 #include "ppm.h"
 
 //-----------------------------------------------------
-void ppm_strip_write(const uint32_t arr[], const int n, const struct ppm_opts_t * const settings, const int height){
+/// Put the number into the buffer without going through printf
+static uint8_t *ppm_put_num(uint8_t *out, const unsigned int v){
+	if(v >= 100){ *out++ = '0' + v / 100; }
+	if(v >= 10){ *out++ = '0' + (v / 10) % 10; }
+	*out++ = '0' + v % 10;
+	return out;
+}
+
+//-----------------------------------------------------
+static int ppm_header_write(const struct ppm_opts_t * const opts, const int height){
+	fprintf(opts->fp, "%s\n%d %d\n255\n", opts->ascii ? "P3" : "P6", opts->width, height);
+	return PPM_ERR_NONE;
+}
+
+//-----------------------------------------------------
+static int ppm_open(struct ppm_opts_t * const opts, const char * const file_name){
+	opts->fp = fopen(file_name, "wb");
+	if(!opts->fp){
+		perror("Error opening file\n");
+		return PPM_ERR_FILE_OPENING;
+	}
+	setvbuf(opts->fp, NULL, _IOFBF, PPM_IO_BUFF_LEN);
+	return PPM_ERR_NONE;
+}
+
+//-----------------------------------------------------
+void ppm_strip_write(const uint32_t arr[], const int n, struct ppm_opts_t * const settings, const int height){
+	if(PPM_ERR_NONE != ppm_row_format(arr, n, settings)){ return; }
 	for(int i = 0; i < height; i++){
-		ppm_pix_array_write(arr, n, settings);
+		fwrite(settings->row, 1, settings->row_len, settings->fp);
 	}
 }
 
@@ -24,16 +53,32 @@ int ppm_pix_write(const union pixel_t * const pixel, FILE * const out){
 
 //-----------------------------------------------------
 int ppm_init(struct ppm_opts_t * const opts){
-	
-	opts->fp = fopen(opts->file_name, "w");
-	if(!opts->fp){
-		perror("Error opening file\n");
-		return PPM_ERR_FILE_OPENING;
+
+	opts->frame = 0;
+
+	// Each frame opens its own file
+	if(opts->sequence == PPM_SEQ_FILES){ return PPM_ERR_NONE; }
+
+	int rc = ppm_open(opts, opts->file_name);
+	if(PPM_ERR_NONE != rc){ return rc; }
+	return ppm_init_fp(opts, opts->fp);
+}
+
+//-----------------------------------------------------
+int ppm_init_fp(struct ppm_opts_t * const opts, FILE * const fp){
+
+	if(opts->sequence == PPM_SEQ_FILES){
+		fprintf(stderr, "[%d] A sequence of files can't go in one that's already open\n", __LINE__);
+		return PPM_ERR_FILE_FP;
 	}
-	
-	// Header
-	fprintf(opts->fp, "P3\n%d %d\n255\n", opts->width, opts->height);
-	
+	opts->frame = 0;
+	opts->fp = fp;
+
+	// Header, a stream has one per frame instead
+	if(opts->sequence == PPM_SEQ_NONE){
+		ppm_header_write(opts, opts->height);
+	}
+
 	return PPM_ERR_NONE;
 }
 
@@ -44,17 +89,102 @@ void ppm_pix_printf(const union pixel_t * const pixel){
 
 //-----------------------------------------------------
 int ppm_deinit(struct ppm_opts_t * const opts){
-	fclose(opts->fp);
+	int rc = PPM_ERR_NONE;
+	if(opts->fp){
+		// A full disk or a reader that's gone only shows up here, the writes themselves are buffered
+		if(ferror(opts->fp)){ rc = PPM_ERR_FILE_WRITE; }
+		if(0 != fclose(opts->fp)){ rc = PPM_ERR_FILE_WRITE; }
+	}
 	opts->fp = NULL;
+	free(opts->row);
+	opts->row = NULL;
+	opts->row_len = opts->row_cap = 0;
+	return rc;
+}
+
+//-----------------------------------------------------
+int ppm_row_format(const uint32_t arr[], const int n, struct ppm_opts_t * const settings){
+
+	const size_t cap = (size_t)n * (settings->ascii ? PPM_ASCII_PIX_LEN : 3);
+	if(settings->row_cap < cap){
+		uint8_t *row = realloc(settings->row, cap);
+		if(!row){
+			fprintf(stderr, "[%d] Out of memory for a row of %d\n", __LINE__, n);
+			return PPM_ERR_NO_MEMORY;
+		}
+		settings->row = row;
+		settings->row_cap = cap;
+	}
+
+	uint8_t *out = settings->row;
+	if(settings->ascii){
+		for(int item = 0; item < n; item++){
+			union pixel_t p;
+			p.rgbeol = arr[item];
+			item == n-1 ? (ppm_pix_set_eol(p)) : (ppm_pix_clr_eol(p));
+			out = ppm_put_num(out, p.r);
+			*out++ = ' ';
+			out = ppm_put_num(out, p.g);
+			*out++ = ' ';
+			out = ppm_put_num(out, p.b);
+			*out++ = ' ';
+			*out++ = p.eol;
+		}
+	}
+	else{
+		for(int item = 0; item < n; item++){
+			union pixel_t p;
+			p.rgbeol = arr[item];
+			*out++ = p.r;
+			*out++ = p.g;
+			*out++ = p.b;
+		}
+	}
+	settings->row_len = out - settings->row;
 	return PPM_ERR_NONE;
 }
 
 //-----------------------------------------------------
-void ppm_pix_array_write(const uint32_t arr[], const int n, const struct ppm_opts_t * const settings){
-	for(int item = 0; item < n; item++ ){
-		union pixel_t p;
-		p.rgbeol = arr[item];
-		item == n-1 ? (ppm_pix_set_eol(p)) : (ppm_pix_clr_eol(p));
-		ppm_pix_write(&p, settings->fp);
+int ppm_frame_write(const uint32_t arr[], const int n, struct ppm_opts_t * const settings){
+
+	if(settings->sequence == PPM_SEQ_FILES){
+		char file_name[PPM_FILEPATH_BUFF_LEN + 16];
+		snprintf(file_name, sizeof(file_name), "%s_%06ld.ppm", settings->file_name, settings->frame);
+		int rc = ppm_open(settings, file_name);
+		if(PPM_ERR_NONE != rc){ return rc; }
 	}
+	else if(!settings->fp){
+		fprintf(stderr, "[%d] Nothing in the &(FILE*)\n", __LINE__);
+		return PPM_ERR_FILE_FP;
+	}
+
+	// Several strips, each width long, split the height between them
+	const int lanes = n > settings->width ? n / settings->width : 1;
+	ppm_header_write(settings, settings->height);
+	for(int lane = 0; lane < lanes; lane++){
+		ppm_strip_write(&arr[(size_t)lane * settings->width], n / lanes, settings, settings->height / lanes);
+	}
+	settings->frame++;
+
+	if(settings->sequence == PPM_SEQ_FILES){
+		const bool failed = ferror(settings->fp) || 0 != fclose(settings->fp);
+		settings->fp = NULL;
+		if(failed){
+			fprintf(stderr, "[%d] Couldn't write frame %ld\n", __LINE__, settings->frame - 1);
+			return PPM_ERR_FILE_WRITE;
+		}
+	}
+	return PPM_ERR_NONE;
+}
+
+//-----------------------------------------------------
+void ppm_pix_array_write(const uint32_t arr[], const int n, struct ppm_opts_t * const settings){
+	if(PPM_ERR_NONE == ppm_row_format(arr, n, settings)){
+		fwrite(settings->row, 1, settings->row_len, settings->fp);
+	}
+}
+
+//-----------------------------------------------------
+uint32_t ppm_pix_get_average(const union pixel_t p){
+	return (p.r+p.g+p.g)/3;
 }
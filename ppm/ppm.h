@@ -11,9 +11,15 @@
 #define PPM_ERR_FILE_OPENING				1
 #define PPM_ERR_FILE_FP						2
 #define PPM_FILEPATH_BUFF_LEN				1024
+#define PPM_ERR_NO_MEMORY					3
+#define PPM_ERR_FILE_WRITE					4		///< Something written didn't make it to the file
+#define PPM_IO_BUFF_LEN						(1 << 20)
+#define PPM_ASCII_PIX_LEN					13		///< Longest "rrr ggg bbb e" a pixel can format to
 
 #include <stdlib.h>
 #include <stdio.h>
+#include <stdint.h>
+#include <stdbool.h>
 
 /**
  Set the red part of the pixel
@@ -98,16 +104,31 @@ union pixel_t{
 };
 
 
+/**
+ How frames are laid out when writing more than one image
+ */
+enum ppm_sequence_t{
+	PPM_SEQ_NONE = 0,		///< A single image, rows get written to it as they come
+	PPM_SEQ_FILES,			///< A whole image per frame, each in its own file_name_NNNNNN.ppm
+	PPM_SEQ_STREAM			///< A whole image per frame, one after the other in the same file
+};
+
 /**
  Options for the PPM file output
  */
 struct ppm_opts_t{
-	char	file_name[PPM_FILEPATH_BUFF_LEN];
+	char	file_name[PPM_FILEPATH_BUFF_LEN];	/// With PPM_SEQ_FILES this is the stem the frame number is added to
 	FILE	*fp;				/// The File pointer
 	int		width;
 	int		height;
 	int		max;				/// This will scale to 255 in the image using the ppm_pix_scale macro
 	void    (*write)(const uint32_t[], const int, const struct ppm_opts_t * const);
+	bool	ascii;				/// P3 rather than binary P6
+	enum ppm_sequence_t	sequence;
+	long	frame;				/// Frames written so far in a sequence
+	uint8_t	*row;				/// The last row formatted, so repeats of it are just a write
+	size_t	row_len;
+	size_t	row_cap;
 };
 
 //-----------------------------------------------------
@@ -120,10 +141,20 @@ struct ppm_opts_t{
 int		 ppm_init(struct ppm_opts_t * const opts);
 
 /**
- Clean up
+ Same as ppm_init, but writing to a file that's already open, which ppm_deinit closes.
+ A sequence of files opens its own, so that can't use this.
+ 
+ @param opts The options, apart from the file name
+ @param fp Where to write to
+ @return ERR_NONE or relevant error code
+ */
+int		 ppm_init_fp(struct ppm_opts_t * const opts, FILE * const fp);
+
+/**
+ Clean up, closing the file
  
  @param opts The options of the PPM file
- @return ERR_NONE
+ @return ERR_NONE, or PPM_ERR_FILE_WRITE if a write or the close failed
  */
 int		 ppm_deinit(struct ppm_opts_t * const opts);
 
@@ -150,7 +181,7 @@ void	 ppm_pix_printf(const union pixel_t * const pixel);
  @param n The array length
  @param settings The PPM settings
  */
-void	 ppm_pix_array_write(const uint32_t arr[], const int n, const struct ppm_opts_t * const settings);
+void	 ppm_pix_array_write(const uint32_t arr[], const int n, struct ppm_opts_t * const settings);
 
 /**
  Averages the R, G and B values
@@ -161,6 +192,28 @@ void	 ppm_pix_array_write(const uint32_t arr[], const int n, const struct ppm_op
 uint32_t ppm_pix_get_average(const union pixel_t p);
 
 
+/**
+ Format an array of pixels as one row into settings->row, in whichever format the file is
+
+ @param arr The array
+ @param n The array length
+ @param settings The PPM settings
+ @return ERR_NONE or relevant error code
+ */
+int		ppm_row_format(const uint32_t arr[], const int n, struct ppm_opts_t * const settings);
+
+/**
+ Write a whole image made of the array repeated settings->height times. With PPM_SEQ_FILES
+ it goes into a new file, otherwise it's appended to the open one. If the array is several
+ settings->width long strips one after the other, they're stacked and share the height.
+
+ @param arr The array
+ @param n The length of it
+ @param settings The settings of PPM file
+ @return ERR_NONE or relevant error code
+ */
+int		ppm_frame_write(const uint32_t arr[], const int n, struct ppm_opts_t * const settings);
+
 /**
  Put a the array repeated a certain number of times
  
@@ -169,6 +222,6 @@ uint32_t ppm_pix_get_average(const union pixel_t p);
  @param settings The settings of PPM file
  @param height The number of strips in pixels
  */
-void	ppm_strip_write(const uint32_t arr[], const int n, const struct ppm_opts_t * const settings, const int height);
+void	ppm_strip_write(const uint32_t arr[], const int n, struct ppm_opts_t * const settings, const int height);
 
 #endif /* ppm_h */
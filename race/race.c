@@ -0,0 +1,152 @@
+//
+//  race.c
+//  Visualiser
+//
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "race.h"
+
+/// The lane this thread is running, which is how the frame callback knows where to put it
+static _Thread_local struct race_lane *race_self = NULL;
+
+//-----------------------------------------------------
+/// Set the caller's counts to what it had plus what every lane has done
+static void race_counts(const struct race * const r, const struct sort_counters * const base){
+	sort_counts = *base;
+	for(int i = 0; i < r->lanes; i++){
+		sort_counts.compares += r->lane[i].counts.compares;
+		sort_counts.swaps += r->lane[i].counts.swaps;
+		sort_counts.writes += r->lane[i].counts.writes;
+	}
+}
+
+//-----------------------------------------------------
+/// The lanes' frame callback. Put the array in the lane's part of the frame then wait for it to go out.
+static void race_frame(const uint32_t arr[], const int n){
+	struct race_lane * const l = race_self;
+	struct race * const r = l->race;
+
+	// Nothing reads the frame until every lane is waiting or finished
+	memcpy(&r->frame[(size_t)l->id * r->n], arr, (size_t)n * sizeof(*arr));
+	l->counts = sort_counts;
+
+	pthread_mutex_lock(&r->lock);
+	if(++r->waiting + r->finished == r->lanes){ pthread_cond_signal(&r->ready); }
+	while(r->step == l->seen){
+		pthread_cond_wait(&r->go, &r->lock);
+	}
+	l->seen = r->step;
+	pthread_mutex_unlock(&r->lock);
+}
+
+//-----------------------------------------------------
+static void *race_run(void *arg){
+	struct race_lane * const l = arg;
+	struct race * const r = l->race;
+
+	race_self = l;
+	memset(&sort_counts, 0, sizeof(sort_counts));
+	radix_init(&radix_engine, r->radix_bits, r->radix_threads);
+
+	l->fn(l->arr, r->n, r->synced ? race_frame : NULL);
+
+	radix_free(&radix_engine);
+	l->counts = sort_counts;
+
+	// Its final state goes in the next frame, not every sort ends on one
+	uint32_t * const slot = &r->frame[(size_t)l->id * r->n];
+	pthread_mutex_lock(&r->lock);
+	if(0 != memcmp(slot, l->arr, (size_t)r->n * sizeof(*slot))){
+		memcpy(slot, l->arr, (size_t)r->n * sizeof(*slot));
+		r->dirty = true;
+	}
+	if(r->waiting + ++r->finished == r->lanes){ pthread_cond_signal(&r->ready); }
+	pthread_mutex_unlock(&r->lock);
+	return NULL;
+}
+
+//-----------------------------------------------------
+bool race_sort(uint32_t arr[], const int n, const sort_fn fn[], const int lanes, gif_cb cb){
+
+	if(lanes < 1){ return true; }
+
+	const size_t len = (size_t)lanes * n;
+	struct race r = { .n = n, .lanes = lanes, .synced = NULL != cb,
+					  .radix_bits = radix_engine.bits, .radix_threads = radix_engine.threads };
+	uint32_t * const copies = alloc_aligned(len * sizeof(*copies));
+	r.frame = alloc_aligned(len * sizeof(*r.frame));
+	r.lane = calloc(lanes, sizeof(*r.lane));
+	if(!copies || !r.frame || !r.lane){
+		fprintf(stderr, "[%d] Out of memory to race %d sorts of %d elements\n", __LINE__, lanes, n);
+		free(copies);
+		free(r.frame);
+		free(r.lane);
+		return false;
+	}
+
+	for(int i = 0; i < lanes; i++){
+		r.lane[i].race = &r;
+		r.lane[i].id = i;
+		r.lane[i].fn = fn[i];
+		r.lane[i].arr = &copies[(size_t)i * n];
+		memcpy(r.lane[i].arr, arr, (size_t)n * sizeof(*arr));
+	}
+	memcpy(r.frame, copies, len * sizeof(*copies));
+
+	pthread_mutex_init(&r.lock, NULL);
+	pthread_cond_init(&r.ready, NULL);
+	pthread_cond_init(&r.go, NULL);
+
+	const struct sort_counters base = sort_counts;
+	if(cb){ cb(r.frame, (int)len); }
+
+	// A lane which doesn't start just stays at the starting line
+	for(int i = 0; i < lanes; i++){
+		if(0 != pthread_create(&r.lane[i].thread, NULL, race_run, &r.lane[i])){
+			fprintf(stderr, "[%d] Couldn't start a thread for lane %d\n", __LINE__, i);
+			r.lane[i].fn = NULL;
+			pthread_mutex_lock(&r.lock);
+			r.finished++;
+			pthread_mutex_unlock(&r.lock);
+		}
+	}
+
+	pthread_mutex_lock(&r.lock);
+	for(;;){
+		while(r.waiting + r.finished < r.lanes){
+			pthread_cond_wait(&r.ready, &r.lock);
+		}
+		if(0 == r.waiting){ break; }
+
+		// Every lane is stopped, so the frame and the counts can be read without the lock
+		r.dirty = false;
+		pthread_mutex_unlock(&r.lock);
+		race_counts(&r, &base);
+		cb(r.frame, (int)len);
+		pthread_mutex_lock(&r.lock);
+
+		r.step++;
+		r.waiting = 0;
+		pthread_cond_broadcast(&r.go);
+	}
+	pthread_mutex_unlock(&r.lock);
+
+	for(int i = 0; i < lanes; i++){
+		if(NULL != r.lane[i].fn){ pthread_join(r.lane[i].thread, NULL); }
+	}
+	race_counts(&r, &base);
+	if(cb && r.dirty){ cb(r.frame, (int)len); }
+
+	memcpy(arr, r.lane[0].arr, (size_t)n * sizeof(*arr));
+
+	pthread_cond_destroy(&r.go);
+	pthread_cond_destroy(&r.ready);
+	pthread_mutex_destroy(&r.lock);
+	free(r.lane);
+	free(r.frame);
+	free(copies);
+	return true;
+}
@@ -0,0 +1,70 @@
+//
+//  race.h
+//  Visualiser
+//
+//  Runs several sorts side by side, each on its own copy of the same array and on
+//  its own thread. Whenever every lane has a frame ready, or has finished, the
+//  lanes' arrays go out as one frame, one after the other, and then they all carry
+//  on. A lane which has finished stays as it ended up until the last one is done.
+//
+
+#ifndef race_h
+#define race_h
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <pthread.h>
+
+#include "sort.h"
+
+struct race;
+
+/**
+ A sort running in the race
+ */
+struct race_lane{
+	struct race				*race;
+	int						id;
+	sort_fn					fn;
+	uint32_t				*arr;			///< Its own copy to sort
+	unsigned long			seen;			///< The last frame it was let go after
+	struct sort_counters	counts;			///< What it had done as of its last frame
+	pthread_t				thread;
+};
+
+/**
+ What the lanes share. The caller bumps step once a frame has gone out.
+ */
+struct race{
+	int					n;
+	int					lanes;
+	struct race_lane	*lane;
+	uint32_t			*frame;			///< Every lane's latest array, one after the other
+	bool				synced;			///< Whether the lanes wait for each frame, only if there's somewhere for it to go
+	int					radix_bits;		///< What each lane sets its own radix_engine up with, copied from the caller's
+	int					radix_threads;
+	unsigned long		step;			///< Goes up each time a frame goes out
+	int					waiting;		///< Lanes with a frame ready for this step
+	int					finished;		///< Lanes which have stopped
+	bool				dirty;			///< A lane has finished since the last frame
+	pthread_mutex_t		lock;
+	pthread_cond_t		ready;			///< Every lane is waiting or finished
+	pthread_cond_t		go;				///< The frame has gone out
+};
+
+//-----------------------------------------------------
+/**
+ Race the sorts on copies of the array. Frames are lanes * n long, and are all handed to
+ cb on the calling thread, the first being the starting line. What each lane does is
+ added to the caller's sort_counts.
+
+ @param arr The array, sorted by the first lane once they're all done
+ @param n The length of it
+ @param fn The sorts, one per lane
+ @param lanes How many there are
+ @param cb Where the frames go, if NULL the lanes run without waiting for each other
+ @return False if there wasn't the memory, in which case nothing was sorted
+ */
+bool	race_sort(uint32_t arr[], const int n, const sort_fn fn[], const int lanes, gif_cb cb);
+
+#endif /* race_h */
@@ -0,0 +1,175 @@
+//
+//  radix.c
+//  Visualiser
+//
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+#include <unistd.h>
+
+#include "radix.h"
+
+/// One thread's share of the histogram counting
+struct radix_count_job{
+	const uint32_t	*key;
+	int				lo;
+	int				hi;
+	int				bits;
+	int				passes;
+	size_t			*hist;		///< passes histograms of 1 << bits each
+	pthread_t		thread;
+};
+
+//-----------------------------------------------------
+static void *radix_count(void *arg){
+	struct radix_count_job * const job = arg;
+	const uint32_t mask = (1u << job->bits) - 1;
+	const size_t buckets = (size_t)1 << job->bits;
+
+	for(int i = job->lo; i < job->hi; i++){
+		uint32_t k = job->key[i];
+		for(int p = 0; p < job->passes; p++){
+			job->hist[p * buckets + (k & mask)]++;
+			k >>= job->bits;
+		}
+	}
+	return NULL;
+}
+
+//-----------------------------------------------------
+bool radix_init(struct radix * const r, const int bits, const int threads){
+	memset(r, 0, sizeof(*r));
+	r->bits = bits ? bits : RADIX_DEFAULT_BITS;
+	r->threads = threads;
+	if(r->bits < 1 || r->bits > RADIX_MAX_BITS){
+		fprintf(stderr, "[%d] A radix digit has to be 1 to %d bits, not %d\n", __LINE__, RADIX_MAX_BITS, r->bits);
+		return false;
+	}
+	return true;
+}
+
+//-----------------------------------------------------
+bool radix_sort_keys(struct radix * const r, uint32_t arr[], uint32_t key[], const int n, radix_pass_cb cb, void *ctx){
+
+	if(n < 2){ return true; }
+
+	uint32_t max = 0;
+	for(int i = 0; i < n; i++){
+		if(key[i] > max){ max = key[i]; }
+	}
+
+	int passes = 0;
+	for(uint32_t m = max; m; m >>= r->bits){ passes++; }
+	if(passes == 0){ return true; }
+
+	int threads = r->threads;
+	if(threads <= 0){
+		threads = (int)sysconf(_SC_NPROCESSORS_ONLN);
+	}
+	if(threads > n / RADIX_THREAD_MIN_LEN){ threads = n / RADIX_THREAD_MIN_LEN; }
+	if(threads < 1){ threads = 1; }
+
+	const size_t buckets = (size_t)1 << r->bits;
+	const size_t hist_len = (size_t)threads * passes * buckets;
+
+	if(r->cap < (size_t)n){
+		uint32_t *buf = realloc(r->buf, (size_t)n * sizeof(*buf));
+		if(buf){ r->buf = buf; }
+		uint32_t *buf_key = realloc(r->buf_key, (size_t)n * sizeof(*buf_key));
+		if(buf_key){ r->buf_key = buf_key; }
+		if(!buf || !buf_key){
+			fprintf(stderr, "[%d] Out of memory for a %d element radix buffer\n", __LINE__, n);
+			return false;
+		}
+		r->cap = n;
+	}
+	if(r->hist_cap < hist_len){
+		size_t *hist = realloc(r->hist, hist_len * sizeof(*hist));
+		if(!hist){
+			fprintf(stderr, "[%d] Out of memory for the radix histograms\n", __LINE__);
+			return false;
+		}
+		r->hist = hist;
+		r->hist_cap = hist_len;
+	}
+	memset(r->hist, 0, hist_len * sizeof(*r->hist));
+
+	// Count every digit of every key at once, split over the threads if there are enough keys
+	struct radix_count_job *jobs = calloc(threads, sizeof(*jobs));
+	if(!jobs){
+		fprintf(stderr, "[%d] Out of memory for %d histogram threads\n", __LINE__, threads);
+		return false;
+	}
+	const int share = n / threads;
+	for(int t = 0; t < threads; t++){
+		jobs[t] = (struct radix_count_job){
+			.key = key,
+			.lo = t * share,
+			.hi = t == threads - 1 ? n : (t + 1) * share,
+			.bits = r->bits,
+			.passes = passes,
+			.hist = &r->hist[(size_t)t * passes * buckets],
+		};
+	}
+	int started = 1;
+	for(; started < threads; started++){
+		if(0 != pthread_create(&jobs[started].thread, NULL, radix_count, &jobs[started])){ break; }
+	}
+	radix_count(&jobs[0]);
+	// Any that didn't start get counted here instead
+	for(int t = started; t < threads; t++){ radix_count(&jobs[t]); }
+	for(int t = 1; t < started; t++){ pthread_join(jobs[t].thread, NULL); }
+	for(int t = 1; t < threads; t++){
+		for(size_t b = 0; b < (size_t)passes * buckets; b++){
+			r->hist[b] += jobs[t].hist[b];
+		}
+	}
+	free(jobs);
+
+	uint32_t *src = arr, *src_key = key;
+	uint32_t *dst = r->buf, *dst_key = r->buf_key;
+	const uint32_t mask = (uint32_t)buckets - 1;
+
+	for(int p = 0; p < passes; p++){
+		size_t * const offset = &r->hist[(size_t)p * buckets];
+		const int shift = p * r->bits;
+
+		// If every key has the same digit here the pass wouldn't move anything
+		if(offset[(src_key[0] >> shift) & mask] == (size_t)n){ continue; }
+
+		size_t total = 0;
+		for(size_t b = 0; b < buckets; b++){
+			const size_t count = offset[b];
+			offset[b] = total;
+			total += count;
+		}
+
+		for(int i = 0; i < n; i++){
+			const size_t pos = offset[(src_key[i] >> shift) & mask]++;
+			dst[pos] = src[i];
+			dst_key[pos] = src_key[i];
+		}
+		if(cb){ cb(dst, dst_key, n, ctx); }
+
+		uint32_t *tmp = src; src = dst; dst = tmp;
+		tmp = src_key; src_key = dst_key; dst_key = tmp;
+	}
+
+	if(src != arr){
+		memcpy(arr, src, (size_t)n * sizeof(*arr));
+		memcpy(key, src_key, (size_t)n * sizeof(*key));
+	}
+	return true;
+}
+
+//-----------------------------------------------------
+void radix_free(struct radix * const r){
+	free(r->buf);
+	free(r->buf_key);
+	free(r->hist);
+	r->buf = r->buf_key = NULL;
+	r->hist = NULL;
+	r->cap = r->hist_cap = 0;
+}
@@ -0,0 +1,68 @@
+//
+//  radix.h
+//  Visualiser
+//
+//  An LSD radix sort on precomputed keys. Every digit's histogram is counted in
+//  one go over the keys, then each digit is a single stable scatter between the
+//  array and a scratch buffer which is kept between sorts.
+//
+
+#ifndef radix_h
+#define radix_h
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+#define RADIX_DEFAULT_BITS					8			///< Base 256
+#define RADIX_MAX_BITS						16
+#define RADIX_THREAD_MIN_LEN				65536		///< Fewer keys than this each and a thread costs more than it saves
+
+/// Called after every scatter pass with wherever the array is at the moment
+typedef void (*radix_pass_cb)(const uint32_t arr[], const uint32_t key[], const int n, void *ctx);
+
+/**
+ The settings and the buffers, which only ever grow
+ */
+struct radix{
+	int			bits;			///< Digit width, 1 - RADIX_MAX_BITS
+	int			threads;		///< Threads to count the histograms on, 0 for one per core
+	uint32_t	*buf;			///< Scratch payload
+	uint32_t	*buf_key;		///< Scratch keys
+	size_t		cap;			///< Length of both scratch buffers
+	size_t		*hist;			///< One histogram per digit per thread
+	size_t		hist_cap;		///< Length of hist
+};
+
+//-----------------------------------------------------
+/**
+ Set up the sorter, no memory is allocated until the first sort
+
+ @param r The sorter
+ @param bits Digit width, 0 for RADIX_DEFAULT_BITS
+ @param threads Threads to count the histograms on, 0 for one per core
+ @return False if bits is out of range
+ */
+bool	radix_init(struct radix * const r, const int bits, const int threads);
+
+/**
+ Sort the array by its keys, moving both
+
+ @param r The sorter
+ @param arr The payload
+ @param key The keys, in step with arr
+ @param n The length of both
+ @param cb Called after each scatter pass, may be NULL
+ @param ctx Given to cb
+ @return False if the buffers couldn't be allocated, in which case nothing moved
+ */
+bool	radix_sort_keys(struct radix * const r, uint32_t arr[], uint32_t key[], const int n, radix_pass_cb cb, void *ctx);
+
+/**
+ Free the buffers
+
+ @param r The sorter
+ */
+void	radix_free(struct radix * const r);
+
+#endif /* radix_h */
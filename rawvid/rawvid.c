@@ -0,0 +1,136 @@
+//
+//  rawvid.c
+//  Visualiser
+//  https://wiki.multimedia.cx/index.php/YUV4MPEG2
+//
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "rawvid.h"
+#include "ppm.h"
+
+//-----------------------------------------------------
+bool rawvid_format_parse(const char * const name, enum rawvid_format_t * const format){
+	if(0 == strcmp(name, "rgb")){ *format = RAWVID_RGB; }
+	else if(0 == strcmp(name, "row")){ *format = RAWVID_ROW; }
+	else if(0 == strcmp(name, "y4m")){ *format = RAWVID_Y4M; }
+	else{ return false; }
+	return true;
+}
+
+//-----------------------------------------------------
+bool rawvid_begin(struct rawvid_opts_t * const opts, const char * const file_name){
+
+	FILE *fp = stdout;
+	if(0 != strcmp(file_name, RAWVID_STDOUT)){
+		fp = fopen(file_name, "wb");
+		if(!fp){
+			perror("Error opening file\n");
+			return false;
+		}
+	}
+	return rawvid_begin_fp(opts, fp);
+}
+
+//-----------------------------------------------------
+bool rawvid_begin_fp(struct rawvid_opts_t * const opts, FILE * const fp){
+
+	opts->fp = fp;
+	setvbuf(opts->fp, NULL, _IOFBF, RAWVID_IO_BUFF_LEN);
+
+	opts->row_cap = (size_t)opts->width * 3;
+	opts->row = malloc(opts->row_cap);
+	if(!opts->row){
+		fprintf(stderr, "[%d] Out of memory for a row of %d\n", __LINE__, opts->width);
+		return false;
+	}
+
+	switch(opts->format){
+		case RAWVID_RGB:
+			break;
+		case RAWVID_ROW:
+			fprintf(opts->fp, "VROW %d %d\n", opts->width, opts->height);
+			break;
+		case RAWVID_Y4M:
+			{
+				const bool rate = opts->fps_num && opts->fps_den;
+				fprintf(opts->fp, "YUV4MPEG2 W%d H%d F%u:%u Ip A1:1 C444\n", opts->width, opts->height, rate ? opts->fps_num : 25, rate ? opts->fps_den : 1);
+			}
+			break;
+	}
+	return !ferror(opts->fp);
+}
+
+//-----------------------------------------------------
+bool rawvid_frame_write(const uint32_t arr[], const int n, struct rawvid_opts_t * const opts){
+
+	// Several strips, each width long, are stacked and share the height
+	const int width = n > opts->width ? opts->width : n;
+	const int lanes = n / width;
+	const int height = opts->height / lanes;
+
+	if((size_t)n * 3 > opts->row_cap){
+		uint8_t * const row = realloc(opts->row, (size_t)n * 3);
+		if(!row){
+			fprintf(stderr, "[%d] Out of memory for a row of %d\n", __LINE__, n);
+			return false;
+		}
+		opts->row = row;
+		opts->row_cap = (size_t)n * 3;
+	}
+	uint8_t *out = opts->row;
+
+	if(opts->format == RAWVID_Y4M){
+		// BT.601 studio swing, a plane at a time so each plane's row can be repeated
+		uint8_t *y = out, *u = out + n, *v = out + 2 * n;
+		for(int item = 0; item < n; item++){
+			union pixel_t p;
+			p.rgbeol = arr[item];
+			y[item] = (uint8_t)(( 66 * p.r + 129 * p.g +  25 * p.b + 128) / 256 + 16);
+			// The chroma is offset by 128 before the shift rather than after, so it's never
+			// negative there and rounds to nearest, where dividing would truncate toward zero
+			u[item] = (uint8_t)((-38 * p.r -  74 * p.g + 112 * p.b + 128 + (128 << 8)) >> 8);
+			v[item] = (uint8_t)((112 * p.r -  94 * p.g -  18 * p.b + 128 + (128 << 8)) >> 8);
+		}
+		fputs("FRAME\n", opts->fp);
+		for(int plane = 0; plane < 3; plane++){
+			for(int lane = 0; lane < lanes; lane++){
+				for(int r = 0; r < height; r++){
+					fwrite(out + plane * n + lane * width, 1, width, opts->fp);
+				}
+			}
+		}
+		return !ferror(opts->fp);
+	}
+
+	for(int item = 0; item < n; item++){
+		union pixel_t p;
+		p.rgbeol = arr[item];
+		*out++ = p.r;
+		*out++ = p.g;
+		*out++ = p.b;
+	}
+
+	// The row format leaves the repeating to whoever reads it
+	const int rows = opts->format == RAWVID_ROW ? 1 : height;
+	for(int lane = 0; lane < lanes; lane++){
+		for(int r = 0; r < rows; r++){
+			fwrite(opts->row + (size_t)lane * width * 3, 3, width, opts->fp);
+		}
+	}
+	return !ferror(opts->fp);
+}
+
+//-----------------------------------------------------
+bool rawvid_end(struct rawvid_opts_t * const opts){
+	bool ok = true;
+	if(opts->fp){
+		ok = 0 == fflush(opts->fp);
+		if(opts->fp != stdout){ ok &= 0 == fclose(opts->fp); }
+	}
+	opts->fp = NULL;
+	free(opts->row);
+	opts->row = NULL;
+	return ok;
+}
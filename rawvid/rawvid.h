@@ -0,0 +1,97 @@
+//
+//  rawvid.h
+//  Visualiser
+//
+//  Streams frames as uncompressed video, to a file or stdout, for feeding
+//  straight into ffmpeg or anything else that reads raw frames.
+//
+//  rgb:    width * height * 3 bytes of rgb24 per frame, no header
+//          ffmpeg -f rawvideo -pix_fmt rgb24 -s WxH -i -
+//  row:    "VROW <width> <height>\n" once, then only the width * 3 bytes of the
+//          one row per frame. Every row of the image is the same, height says how
+//          many times to repeat it. A race has a row per sort, which share the height.
+//          ffmpeg -f rawvideo -pix_fmt rgb24 -s Wx1 -i - -vf scale=W:H:flags=neighbor
+//  y4m:    YUV4MPEG2, 4:4:4 so there's no chroma subsampling to smear the columns
+//          ffmpeg -i -
+//
+
+#ifndef rawvid_h
+#define rawvid_h
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stddef.h>
+
+#define RAWVID_STDOUT						"-"
+#define RAWVID_IO_BUFF_LEN					(1 << 20)
+
+/// What goes down the pipe
+enum rawvid_format_t{
+	RAWVID_RGB = 0,		///< Whole rgb24 frames
+	RAWVID_ROW,			///< One rgb24 row per frame, after a header giving the height
+	RAWVID_Y4M			///< YUV4MPEG2
+};
+
+/**
+ Options for the raw video output
+ */
+struct rawvid_opts_t{
+	FILE					*fp;
+	enum rawvid_format_t	format;
+	int						width;
+	int						height;
+	unsigned int			fps_num;	///< Frames per second as fps_num / fps_den, so a delay in centiseconds fits exactly
+	unsigned int			fps_den;	///< 25 frames a second if either is 0
+	uint8_t					*row;		///< The frame's row, rgb24 or each YUV plane one after the other
+	size_t					row_cap;
+};
+
+//-----------------------------------------------------
+/**
+ Open the output and write the stream header if the format has one
+
+ @param opts The options, format, width, height and frame rate set
+ @param file_name Where to write, RAWVID_STDOUT for stdout
+ @return Success or not
+ */
+bool	rawvid_begin(struct rawvid_opts_t * const opts, const char * const file_name);
+
+/**
+ Same as rawvid_begin, but writing to a file that's already open. rawvid_end closes it.
+
+ @param opts The options, format, width, height and frame rate set
+ @param fp Where to write
+ @return Success or not
+ */
+bool	rawvid_begin_fp(struct rawvid_opts_t * const opts, FILE * const fp);
+
+/**
+ Write a frame of the array, height rows of it. If the array is several width long
+ strips one after the other, they're stacked and share the height.
+
+ @param arr The array
+ @param n The length of it
+ @param opts The options
+ @return Success or not, it fails if the reader has gone away
+ */
+bool	rawvid_frame_write(const uint32_t arr[], const int n, struct rawvid_opts_t * const opts);
+
+/**
+ Flush and close, unless it was stdout
+
+ @param opts The options
+ @return Success or not
+ */
+bool	rawvid_end(struct rawvid_opts_t * const opts);
+
+/**
+ Get the format from its name
+
+ @param name rgb, row or y4m
+ @param format Where to put it
+ @return Whether it was a known name
+ */
+bool	rawvid_format_parse(const char * const name, enum rawvid_format_t * const format);
+
+#endif /* rawvid_h */
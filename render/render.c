@@ -0,0 +1,468 @@
+//
+//  render.c
+//  Visualiser
+//
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <assert.h>
+
+#include "render.h"
+#include "simd.h"
+
+static _Thread_local struct render *render = NULL;	///< The one the callbacks on this thread use
+
+//-----------------------------------------------------
+static void render_free(struct render * const r){
+	free(r->gif);
+	free(r->gif_idx);
+	free(r->gif_last);
+	free(r->held);
+	r->gif = NULL;
+	r->gif_idx = NULL;
+	r->gif_last = NULL;
+	r->held = NULL;
+}
+
+//-----------------------------------------------------
+static bool render_init(struct render * const r, const int numbers, const int height, const int lanes){
+	memset(r, 0, sizeof(*r));
+	r->numbers = numbers;
+	r->height = height;
+	r->lanes = lanes;
+	r->gif = alloc_aligned((size_t)numbers * height * lanes * sizeof(*r->gif));
+	r->gif_idx = alloc_aligned((size_t)numbers * height * lanes * sizeof(*r->gif_idx));
+	r->gif_last = alloc_aligned((size_t)numbers * lanes * sizeof(*r->gif_last));
+	r->held = alloc_aligned((size_t)numbers * lanes * sizeof(*r->held));
+	if(!r->gif || !r->gif_idx || !r->gif_last || !r->held){
+		fprintf(stderr, "[%d] Not enough memory for a %d x %d image\n", __LINE__, numbers, height * lanes);
+		render_free(r);
+		return false;
+	}
+	return true;
+}
+
+//-----------------------------------------------------
+/// Write the new array to a gif frame
+static void gif_pix_array_write(const uint32_t arr[], const int n){
+
+	assert(n == render->numbers * render->lanes);
+
+	stats_begin(&render->stats, STATS_BUILD);
+	for(int lane = 0; lane < render->lanes; lane++){
+		union pixel_t * const strip = &render->gif[(size_t)lane * render->numbers * render->height];
+		simd_row_build(&arr[(size_t)lane * render->numbers], &strip->rgbeol, render->numbers);
+		simd_rows_replicate(strip, (size_t)render->numbers * sizeof(*strip), render->height);
+	}
+	stats_end(&render->stats, STATS_BUILD);
+
+	stats_begin(&render->stats, STATS_ENCODE);
+	gif_write_frame(&render->writer, (uint8_t*)render->gif, 8, false);
+	stats_end(&render->stats, STATS_ENCODE);
+	render->stats.frames++;
+}
+
+//-----------------------------------------------------
+/// Send indexed frame data, width * height * lanes indices, to the writer, or to the compression pool if it's running
+static void gif_idx_write(const uint8_t idx[], const int left, const int width, const bool transparent){
+	stats_begin(&render->stats, STATS_ENCODE);
+	if(render->idx_pool.threads){
+		idxgif_pool_write_rect(&render->idx_pool, idx, left, 0, width, render->height * render->lanes, transparent);
+	}
+	else{
+		idxgif_write_rect(&render->idx_writer, idx, left, 0, width, render->height * render->lanes, transparent);
+	}
+	stats_end(&render->stats, STATS_ENCODE);
+	render->stats.frames++;
+}
+
+//-----------------------------------------------------
+/// Write the new array to a gif frame using the global palette. Each element already carries
+/// its palette index in the eol byte, so this is one row of byte copies then a few memcpys for the rest.
+static void gif_pix_array_write_indexed(const uint32_t arr[], const int n){
+
+	assert(n == render->numbers * render->lanes);
+
+	stats_begin(&render->stats, STATS_BUILD);
+	for(int lane = 0; lane < render->lanes; lane++){
+		uint8_t * const strip = &render->gif_idx[(size_t)lane * render->numbers * render->height];
+		simd_row_indices(&arr[(size_t)lane * render->numbers], strip, render->numbers);
+		simd_rows_replicate(strip, render->numbers, render->height);
+	}
+	stats_end(&render->stats, STATS_BUILD);
+	gif_idx_write(render->gif_idx, 0, render->numbers, false);
+}
+
+//-----------------------------------------------------
+/// Whether a column has changed in any strip since the last delta frame
+static inline bool gif_column_changed(const uint32_t arr[], const int column){
+	for(int lane = 0; lane < render->lanes; lane++){
+		const size_t item = (size_t)lane * render->numbers + column;
+		if(arr[item] != render->gif_last[item]){ return true; }
+	}
+	return false;
+}
+
+//-----------------------------------------------------
+/// Write only the columns which changed since the last frame. The unchanged ones in between
+/// are left transparent so the previous frame shows through.
+static void gif_pix_array_write_delta(const uint32_t arr[], const int n){
+
+	assert(n == render->numbers * render->lanes);
+
+	int lo = 0, hi = render->numbers - 1;
+	if(render->gif_last_valid){
+		while(lo < render->numbers && !gif_column_changed(arr, lo)){ lo++; }
+		if(lo == render->numbers){ return; } // Nothing moved
+		while(!gif_column_changed(arr, hi)){ hi--; }
+	}
+
+	stats_begin(&render->stats, STATS_BUILD);
+	const int width = hi - lo + 1;
+	for(int lane = 0; lane < render->lanes; lane++){
+		const uint32_t * const row = &arr[(size_t)lane * render->numbers];
+		uint32_t * const last = &render->gif_last[(size_t)lane * render->numbers];
+		uint8_t * const strip = &render->gif_idx[(size_t)lane * width * render->height];
+		for(int item = lo; item <= hi; item++){
+			uint8_t i = IDXGIF_TRANSPARENT;
+			if(!render->gif_last_valid || row[item] != last[item]){
+				i = ((union pixel_t)row[item]).eol;
+			}
+			strip[item - lo] = i;
+		}
+		simd_rows_replicate(strip, width, render->height);
+		memcpy(&last[lo], &row[lo], width * sizeof(*arr));
+	}
+	stats_end(&render->stats, STATS_BUILD);
+
+	gif_idx_write(render->gif_idx, lo, width, render->gif_last_valid);
+	render->gif_last_valid = true;
+}
+
+//-----------------------------------------------------
+/// Hand the frame to the encoder thread rather than writing it here
+static void gif_pix_array_write_pipelined(const uint32_t arr[], const int n){
+	pipeline_push(&render->frame_pipeline, arr, n);
+}
+
+//-----------------------------------------------------
+/// Write a frame on the encoder thread, which has to be told which render it's for
+static void gif_pipeline_drain(const uint32_t arr[], const int n){
+	render = pipeline_ctx();
+	render->pipeline_sink(arr, n);
+}
+
+//-----------------------------------------------------
+/// Write the frame being kept back, lasting for itself and every repeat of it
+static void gif_repeat_flush(void){
+	if(!render->held_valid){ return; }
+	const unsigned int delay = render->delay * (render->held_repeats + 1);
+	render->writer.delay = delay;
+	render->idx_writer.delay = delay;
+	if(render->held_written && render->indexed){
+		// It's showing already so only the time is needed, and the delta writer would drop it
+		// as unchanged, so a column of nothing but transparent pixels carries it instead
+		memset(render->gif_idx, IDXGIF_TRANSPARENT, (size_t)render->height * render->lanes);
+		gif_idx_write(render->gif_idx, 0, 1, true);
+	}
+	else{
+		render->held_sink(render->held, render->numbers * render->lanes);
+	}
+	render->writer.delay = render->idx_writer.delay = render->delay;
+	render->held_valid = false;
+}
+
+//-----------------------------------------------------
+/// Keep each frame back until the next different one comes along. The ones in between are
+/// the same picture, so rather than encoding them again the one kept back lasts longer.
+/// The sorts count every swap and write, so if those haven't moved the frame can't have
+/// changed. If they have it still might not have, a merge of a run that's already in order
+/// writes everything back where it was, so then the frames are compared.
+static void gif_pix_array_write_repeat(const uint32_t arr[], const int n){
+
+	const unsigned long moved = sort_counts.swaps + sort_counts.writes;
+	if(render->held_valid &&
+	   ((render->held_counts && moved == render->held_moved) || 0 == memcmp(arr, render->held, (size_t)n * sizeof(*arr)))){
+		render->held_moved = moved;
+		render->stats.repeats++;
+		// A Gif's delay is 16 bit, so a frame that lasts longer than that takes more than one to carry its time
+		if((render->held_repeats + 2UL) * render->delay <= UINT16_MAX){
+			render->held_repeats++;
+			return;
+		}
+		gif_repeat_flush();
+		render->held_written = true;
+	}
+	else{
+		gif_repeat_flush();
+		memcpy(render->held, arr, (size_t)n * sizeof(*arr));
+		render->held_written = false;
+	}
+	render->held_valid = true;
+	render->held_repeats = 0;
+	render->held_moved = moved;
+}
+
+//-----------------------------------------------------
+/// Put the repeat stage in front of the writer. The counts can only be trusted if the sort
+/// runs on the thread the frames are written on.
+static gif_cb gif_repeat_begin(gif_cb sink, const bool counts){
+	render->held_valid = false;
+	render->held_written = false;
+	render->held_counts = counts;
+	render->held_sink = sink;
+	return gif_pix_array_write_repeat;
+}
+
+//-----------------------------------------------------
+/// Only pass on the frames which are due, so that the budget is spread evenly over the
+/// operations the sort does. The rest are dropped without being copied anywhere.
+static void gif_pix_array_write_budget(const uint32_t arr[], const int n){
+
+	// Frame k is due once k / (frames - 1) of the operations are done
+	const unsigned long ops = sort_ops();
+	if(render->budget_next >= render->budget_frames || ops * (render->budget_frames - 1) < render->budget_next * render->budget_ops){ return; }
+
+	render->budget_sink(arr, n);
+	render->budget_next = (ops * (render->budget_frames - 1)) / render->budget_ops + 1;
+}
+
+//-----------------------------------------------------
+/// Count what the sort does on a copy of the array, then set up the frame budget to spread
+/// the frames over that many operations. NULL if there wasn't the memory to count.
+static gif_cb budget_begin(const uint32_t arr[], const int n, const int sorter, const unsigned long frames, gif_cb sink){
+	uint32_t *dry_run = alloc_aligned((size_t)n * sizeof(*arr));
+	if(NULL == dry_run){
+		fprintf(stderr, "[%d] Not enough memory to count the operations\n", __LINE__);
+		return NULL;
+	}
+	memcpy(dry_run, arr, (size_t)n * sizeof(*arr));
+	memset(&sort_counts, 0, sizeof(sort_counts));
+	sorters[sorter].perform[SORT_ASCENDING](dry_run, n, NULL);
+	free(dry_run);
+
+	render->budget_ops = sort_ops() > 0 ? sort_ops() : 1;
+	render->budget_frames = frames > 1 ? frames : 2;
+	render->budget_next = 0;
+	render->budget_sink = sink;
+	memset(&sort_counts, 0, sizeof(sort_counts));
+	return gif_pix_array_write_budget;
+}
+
+//-----------------------------------------------------
+/// Time how long the sort spends handing over each frame
+static void gif_pix_array_write_timed(const uint32_t arr[], const int n){
+	stats_begin(&render->stats, STATS_FRAMES);
+	render->stats_sink(arr, n);
+	stats_end(&render->stats, STATS_FRAMES);
+}
+
+//-----------------------------------------------------
+/// Write the array as a whole PPM image in the sequence
+static void ppm_frame_write_cb(const uint32_t arr[], const int n){
+	stats_begin(&render->stats, STATS_ENCODE);
+	if(PPM_ERR_NONE != ppm_frame_write(arr, n, &render->ppm_settings)){ render->ppm_failed = true; }
+	stats_end(&render->stats, STATS_ENCODE);
+	render->stats.frames++;
+}
+
+//-----------------------------------------------------
+/// Write the array as a frame of raw video
+static void rawvid_frame_write_cb(const uint32_t arr[], const int n){
+	stats_begin(&render->stats, STATS_ENCODE);
+	rawvid_frame_write(arr, n, &render->video);
+	stats_end(&render->stats, STATS_ENCODE);
+	render->stats.frames++;
+}
+
+//-----------------------------------------------------
+/// Open the sink and start whichever writer the format needs, giving back the callback that writes a frame
+static gif_cb render_open(struct render * const r){
+
+	const int height = r->height * r->lanes;
+	FILE *fp = NULL;
+	switch(r->opts.format){
+		case RENDER_PPM_FILES:
+			if(SINK_PATH != r->out->kind){
+				fprintf(stderr, "[%d] A sequence of PPM files needs a path to name them after\n", __LINE__);
+				return NULL;
+			}
+			strncpy(r->ppm_settings.file_name, r->out->path, sizeof(r->ppm_settings.file_name) - 1);
+			// Fall through
+		case RENDER_PPM_STREAM:
+			r->ppm_settings.width = r->numbers;
+			r->ppm_settings.height = height;
+			r->ppm_settings.max = 255;
+			r->ppm_settings.ascii = r->opts.ascii;
+			r->ppm_settings.sequence = RENDER_PPM_FILES == r->opts.format ? PPM_SEQ_FILES : PPM_SEQ_STREAM;
+			if(PPM_SEQ_FILES == r->ppm_settings.sequence){
+				if(PPM_ERR_NONE != ppm_init(&r->ppm_settings)){ return NULL; }
+			}
+			else if(NULL == (fp = sink_open(r->out)) || PPM_ERR_NONE != ppm_init_fp(&r->ppm_settings, fp)){ return NULL; }
+			return ppm_frame_write_cb;
+
+		case RENDER_VIDEO:
+			r->video.format = r->opts.video;
+			r->video.width = r->numbers;
+			r->video.height = height;
+			// The delay is in centiseconds, so 100 of them a second over it
+			r->video.fps_num = 100;
+			r->video.fps_den = r->opts.delay;
+			if(NULL == (fp = sink_open(r->out))){ return NULL; }
+			if(!rawvid_begin_fp(&r->video, fp)){
+				rawvid_end(&r->video);
+				return NULL;
+			}
+			return rawvid_frame_write_cb;
+
+		case RENDER_GIF:
+			break;
+	}
+
+	if(!r->indexed){
+		r->writer.delay = r->opts.delay;
+		r->writer.size.width = r->numbers;
+		r->writer.size.height = height;
+		return gif_begin(&r->writer, r->out->path) ? gif_pix_array_write : NULL;
+	}
+
+	r->idx_writer.delay = r->opts.delay;
+	r->idx_writer.size.width = r->numbers;
+	r->idx_writer.size.height = height;
+	if(NULL == (fp = sink_open(r->out)) || !idxgif_begin_fp(&r->idx_writer, fp)){ return NULL; }
+	if(r->opts.parallel && !idxgif_pool_start(&r->idx_pool, &r->idx_writer, r->opts.threads)){
+		idxgif_end(&r->idx_writer);
+		return NULL;
+	}
+	return r->opts.delta ? gif_pix_array_write_delta : gif_pix_array_write_indexed;
+}
+
+//-----------------------------------------------------
+/// Finish whichever writer render_open started
+static bool render_close(struct render * const r){
+	switch(r->opts.format){
+		case RENDER_PPM_FILES:
+		case RENDER_PPM_STREAM:
+			return PPM_ERR_NONE == ppm_deinit(&r->ppm_settings) && !r->ppm_failed;
+		case RENDER_VIDEO:
+			return rawvid_end(&r->video);
+		case RENDER_GIF:
+			break;
+	}
+	return r->indexed ? idxgif_end(&r->idx_writer) : gif_end(&r->writer);
+}
+
+//-----------------------------------------------------
+bool render_begin(struct render * const r, uint32_t arr[], const int n, const int lanes, const struct render_opts * const opts, struct sink * const out){
+
+	const bool gif = RENDER_GIF == opts->format;
+
+	// Gif sizes are 16 bit
+	if(gif && (n > UINT16_MAX || (long)opts->height * lanes > UINT16_MAX)){
+		fprintf(stderr, "[%d] A Gif can't be more than %d pixels either way\n", __LINE__, UINT16_MAX);
+		return false;
+	}
+	if(!render_init(r, n, opts->height, lanes)){ return false; }
+	r->opts = *opts;
+	r->out = out;
+	r->stats.enabled = opts->stats;
+	render = r;
+
+	// The colours never change during a run, so one palette built now does for every frame.
+	// The delta frames need that too, and so does compressing frames independently, so they're always indexed.
+	r->opts.delta &= gif;
+	r->opts.parallel &= gif;
+	r->indexed = gif && (opts->indexed || r->opts.delta || r->opts.parallel);
+	if(r->indexed && !idxgif_palette_build(&r->idx_writer.palette, arr, n)){
+		if(SINK_PATH == out->kind){
+			fprintf(stderr, "Too many colours for a single palette, quantising each frame\n");
+			r->indexed = r->opts.delta = r->opts.parallel = false;
+		}
+		else{
+			idxgif_palette_cube(&r->idx_writer.palette);
+		}
+	}
+	else if(gif && !r->indexed && SINK_PATH != out->kind){
+		idxgif_palette_cube(&r->idx_writer.palette);
+		r->indexed = true;
+	}
+	// From here on every element carries its palette index around with it
+	if(r->indexed){ idxgif_palette_tag(&r->idx_writer.palette, arr, n); }
+
+	gif_cb frame_write = render_open(r);
+	if(NULL == frame_write){
+		fprintf(stderr, "[%d] Couldn't start writing the output\n", __LINE__);
+		render_free(r);
+		render = NULL;
+		return false;
+	}
+
+	// A PPM or a video has no delays to put repeats into, each frame is the same length
+	if(gif){
+		r->delay = opts->delay;
+		frame_write = gif_repeat_begin(frame_write, !opts->pipelined && opts->sorter >= 0);
+	}
+
+	bool ok = true;
+	if(opts->pipelined){
+		r->pipeline_sink = frame_write;
+		ok = pipeline_start(&r->frame_pipeline, PIPELINE_DEFAULT_SLOTS, n * lanes, gif_pipeline_drain, r);
+		frame_write = gif_pix_array_write_pipelined;
+	}
+
+	// Count what the sort does on a copy first, so the frames can be spread over it
+	if(ok && opts->frames > 0 && opts->sorter >= 0){
+		frame_write = budget_begin(arr, n, opts->sorter, opts->frames, frame_write);
+		ok = NULL != frame_write;
+	}
+	if(!ok){
+		r->held_valid = false;
+		render_end(r);
+		return false;
+	}
+
+	if(r->stats.enabled){
+		r->stats_sink = frame_write;
+		frame_write = gif_pix_array_write_timed;
+	}
+	r->frame = frame_write;
+	return true;
+}
+
+//-----------------------------------------------------
+bool render_end(struct render * const r){
+	render = r;
+	pipeline_finish(&r->frame_pipeline);
+	if(RENDER_GIF == r->opts.format){ gif_repeat_flush(); }
+
+	bool ok = true;
+	if(r->idx_pool.threads){ ok &= idxgif_pool_finish(&r->idx_pool); }
+	ok &= render_close(r);
+	render_free(r);
+	render = NULL;
+	return ok;
+}
+
+//-----------------------------------------------------
+bool render_sort(struct render * const r, uint32_t arr[], const int n, const struct render_opts * const opts, struct sink * const out){
+
+	const int lanes = sort_lanes(opts->sorter);
+	if(!render_begin(r, arr, n, lanes, opts, out)){ return false; }
+
+	memset(&sort_counts, 0, sizeof(sort_counts));
+	stats_begin(&r->stats, STATS_SORT);
+	// The race puts its own starting line out
+	if(1 == lanes){ r->frame(arr, n); }
+	sorters[opts->sorter].perform[SORT_ASCENDING](arr, n, r->frame);
+	stats_end(&r->stats, STATS_SORT);
+
+	return render_end(r);
+}
+
+//-----------------------------------------------------
+uint32_t render_tag(const uint32_t value){
+	uint32_t v = value;
+	if(render->indexed){ idxgif_palette_tag(&render->idx_writer.palette, &v, 1); }
+	return v;
+}
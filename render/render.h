@@ -0,0 +1,147 @@
+//
+//  render.h
+//  Visualiser
+//
+//  Turns a sort into an animation, without any of the command line, so it can be
+//  done in process. A render owns the frame buffers and the writer for its format,
+//  and its frame callback is what a sort gets handed. The bytes go to a sink, so
+//  they can end up in a file, down a socket or in memory.
+//
+//  The sorts only give a frame the array, so the callbacks find their render through
+//  a pointer which is per thread. render_begin points it at the render, so renders on
+//  different threads never see each other's, but a thread only has one at a time.
+//
+//  gif-h only writes files it opens itself, so a Gif going anywhere else is always
+//  indexed. If the colours don't fit one palette they go to the nearest in a colour cube.
+//
+
+#ifndef render_h
+#define render_h
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdio.h>
+
+#include "sort.h"
+#include "sink.h"
+#include "ppm.h"
+#include "idxgif.h"
+#include "pipeline.h"
+#include "rawvid.h"
+#include "stats.h"
+#include "gif-h/gif.h"
+
+/// What the frames are written as
+enum render_format{
+	RENDER_GIF = 0,		///< An animated Gif
+	RENDER_PPM_FILES,	///< A PPM per frame, named after the sink's path, which has to be a SINK_PATH
+	RENDER_PPM_STREAM,	///< A PPM per frame, one after the other
+	RENDER_VIDEO		///< Raw video, see rawvid.h
+};
+
+/**
+ How to render
+ */
+struct render_opts{
+	enum render_format		format;
+	int						sorter;			///< Index in sorters of the sort making the frames, -1 if it's not one this thread runs
+	int						height;			///< Of each strip, in pixels
+	unsigned int			delay;			///< Between frames, in 100ths of a second, 0 for no repeat
+	bool					indexed;		///< One palette for the whole Gif, if the colours fit
+	bool					delta;			///< Only write what changed, implies indexed
+	bool					parallel;		///< Compress frames on several threads, implies indexed
+	int						threads;		///< How many for that, 0 for one per core
+	bool					pipelined;		///< Encode on a thread of its own while the sort carries on
+	unsigned long			frames;			///< Make at most this many, spread evenly over the sort, 0 for every one
+	bool					ascii;			///< P3 PPMs rather than P6
+	enum rawvid_format_t	video;			///< Which raw video
+	bool					stats;			///< Time where it all goes
+};
+
+/**
+ Everything the frame callbacks need
+ */
+struct render{
+	struct render_opts		opts;
+	struct sink				*out;				///< Where the bytes go
+	gif_cb					frame;				///< What to give the sort
+	bool					indexed;			///< Whether the elements carry palette indices, which render_tag gives values coming back in
+	int						numbers;			///< Length of the array to sort
+	int						height;				///< Output image strip height
+	int						lanes;				///< Strips stacked in each frame, more than one when racing
+	union pixel_t			*gif;				///< The Image buffer, numbers * height * lanes
+	uint8_t					*gif_idx;			///< Palette indices for the indexed frames, numbers * height * lanes
+	uint32_t				*gif_last;			///< The frame as of the last emitted delta frame, numbers * lanes
+	bool					gif_last_valid;		///< Whether there has been a delta frame yet
+	unsigned int			delay;				///< Each frame's own delay, repeats add theirs on to the one before
+	uint32_t				*held;				///< The last different frame, kept back until it's known how long it lasts, numbers * lanes
+	bool					held_valid;			///< Whether there's a frame being kept back
+	bool					held_written;		///< Whether it's gone out already, and this is only more time for it
+	unsigned int			held_repeats;		///< Frames since then which were the same
+	unsigned long			held_moved;			///< Swaps and writes as of it, if the sort is on this thread
+	bool					held_counts;		///< Whether the sort is on this thread, so its counts can say nothing moved
+	gif_cb					held_sink;			///< Where the frames go once they're different
+	unsigned long			budget_ops;			///< How many operations the whole sort does
+	unsigned long			budget_frames;		///< How many frames to spread over them
+	unsigned long			budget_next;		///< Which of those frames is due next
+	gif_cb					budget_sink;		///< Where the frames that make the cut go
+	gif_cb					pipeline_sink;		///< Where the frames go on the encoder thread
+	gif_cb					stats_sink;			///< Where the frames go once they've been timed
+	struct gif_writer		writer;				///< The writer
+	struct idxgif_writer	idx_writer;			///< The writer for the indexed frames
+	struct pipeline			frame_pipeline;		///< Carries frames to the encoder thread
+	struct idxgif_pool		idx_pool;			///< Compresses indexed frames on several cores, if threads is set
+	struct ppm_opts_t		ppm_settings;		///< The PPM file(s) when writing those instead
+	bool					ppm_failed;			///< Whether one of the PPM files couldn't be written
+	struct rawvid_opts_t	video;				///< The raw video stream when writing that instead
+	struct stats			stats;				///< Where the time went, if opts.stats
+};
+
+//-----------------------------------------------------
+/**
+ Allocate the buffers, open the sink and write the header. A Gif with one palette
+ puts each element's index in its eol byte, so the array has to be the one sorted.
+ Then the frames go to frame, on this thread, until render_end.
+
+ @param r The render
+ @param arr The array as it starts out
+ @param n The length of it
+ @param lanes How many strips each frame has, see sort_lanes
+ @param opts How to render it
+ @param out Where the bytes go, which has to last until render_end
+ @return False if it couldn't be started, nothing needs ending then
+ */
+bool	render_begin(struct render * const r, uint32_t arr[], const int n, const int lanes, const struct render_opts * const opts, struct sink * const out);
+
+/**
+ Write out whatever is still in flight, finish the output and free the buffers.
+ The stats are still there afterwards.
+
+ @param r The render
+ @return Whether everything made it into the sink
+ */
+bool	render_end(struct render * const r);
+
+/**
+ Begin, sort the array with opts->sorter, smallest key first, and end. If that's
+ the radix sort the thread's radix_engine has to have been set up.
+
+ @param r The render
+ @param arr The array, which ends up sorted
+ @param n The length of it
+ @param opts How to render it
+ @param out Where the bytes go
+ @return Whether the whole animation made it into the sink
+ */
+bool	render_sort(struct render * const r, uint32_t arr[], const int n, const struct render_opts * const opts, struct sink * const out);
+
+/**
+ Give a value coming back in, out of a trace say, its palette index, if the
+ render on this thread is indexed
+
+ @param value The pixel
+ @return It with the index in the eol byte
+ */
+uint32_t	render_tag(const uint32_t value);
+
+#endif /* render_h */
@@ -0,0 +1,157 @@
+//
+//  simd.c
+//  Visualiser
+//
+
+#include <string.h>
+
+#include "simd.h"
+
+#if defined(__x86_64__) || (defined(__i386__) && defined(__SSE2__))
+#define SIMD_X86							1
+#include <immintrin.h>
+#endif
+
+#ifdef SIMD_X86
+#define SIMD_EOL_MASK						0x00FFFFFFu		///< Everything but the eol byte of a pixel_t
+#define SIMD_DIV3_MAGIC						0x5556			///< (x * this) >> 16 is x / 3 for anything up to 3 * 255
+#endif
+
+/// The scalar key, kept in step with ppm_pix_get_average. Goes by byte so it's right
+/// whichever way round the machine is, the vector versions are only built for x86.
+static inline uint32_t simd_average(const uint32_t * const v){
+	const uint8_t * const b = (const uint8_t *)v;
+	return (b[0] + b[1] + b[1]) / 3;
+}
+
+#ifdef SIMD_X86
+
+//-----------------------------------------------------
+/// Batch jobs can get here from several threads at once, they all work out the same answer
+static int simd_has_avx2(void){
+	static _Atomic int has = -1;
+	if(has < 0){
+		__builtin_cpu_init();
+		has = __builtin_cpu_supports("avx2") ? 1 : 0;
+	}
+	return has;
+}
+
+//-----------------------------------------------------
+__attribute__((target("avx2")))
+static int simd_pix_averages_avx2(const uint32_t arr[], uint32_t key[], const int n){
+	const __m256i byte = _mm256_set1_epi32(0xFF);
+	const __m256i div3 = _mm256_set1_epi32(SIMD_DIV3_MAGIC);
+	int i = 0;
+	for(; i + 8 <= n; i += 8){
+		const __m256i v = _mm256_loadu_si256((const __m256i *)&arr[i]);
+		const __m256i r = _mm256_and_si256(v, byte);
+		const __m256i g = _mm256_and_si256(_mm256_srli_epi32(v, 8), byte);
+		const __m256i sum = _mm256_add_epi32(r, _mm256_add_epi32(g, g));
+		// The sums fit in the low 16 bits and the high halves of div3 are 0
+		_mm256_storeu_si256((__m256i *)&key[i], _mm256_mulhi_epu16(sum, div3));
+	}
+	return i;
+}
+
+//-----------------------------------------------------
+static int simd_pix_averages_sse2(const uint32_t arr[], uint32_t key[], const int n){
+	const __m128i byte = _mm_set1_epi32(0xFF);
+	const __m128i div3 = _mm_set1_epi32(SIMD_DIV3_MAGIC);
+	int i = 0;
+	for(; i + 4 <= n; i += 4){
+		const __m128i v = _mm_loadu_si128((const __m128i *)&arr[i]);
+		const __m128i r = _mm_and_si128(v, byte);
+		const __m128i g = _mm_and_si128(_mm_srli_epi32(v, 8), byte);
+		const __m128i sum = _mm_add_epi32(r, _mm_add_epi32(g, g));
+		_mm_storeu_si128((__m128i *)&key[i], _mm_mulhi_epu16(sum, div3));
+	}
+	return i;
+}
+
+//-----------------------------------------------------
+__attribute__((target("avx2")))
+static int simd_row_build_avx2(const uint32_t arr[], uint32_t row[], const int n){
+	const __m256i mask = _mm256_set1_epi32(SIMD_EOL_MASK);
+	int i = 0;
+	for(; i + 8 <= n; i += 8){
+		const __m256i v = _mm256_loadu_si256((const __m256i *)&arr[i]);
+		_mm256_storeu_si256((__m256i *)&row[i], _mm256_and_si256(v, mask));
+	}
+	return i;
+}
+
+//-----------------------------------------------------
+static int simd_row_build_sse2(const uint32_t arr[], uint32_t row[], const int n){
+	const __m128i mask = _mm_set1_epi32(SIMD_EOL_MASK);
+	int i = 0;
+	for(; i + 4 <= n; i += 4){
+		const __m128i v = _mm_loadu_si128((const __m128i *)&arr[i]);
+		_mm_storeu_si128((__m128i *)&row[i], _mm_and_si128(v, mask));
+	}
+	return i;
+}
+
+//-----------------------------------------------------
+static int simd_row_indices_sse2(const uint32_t arr[], uint8_t idx[], const int n){
+	int i = 0;
+	for(; i + 16 <= n; i += 16){
+		// Each eol byte down to the bottom of its lane, then narrow 32 -> 16 -> 8 bits
+		const __m128i a = _mm_srli_epi32(_mm_loadu_si128((const __m128i *)&arr[i]), 24);
+		const __m128i b = _mm_srli_epi32(_mm_loadu_si128((const __m128i *)&arr[i + 4]), 24);
+		const __m128i c = _mm_srli_epi32(_mm_loadu_si128((const __m128i *)&arr[i + 8]), 24);
+		const __m128i d = _mm_srli_epi32(_mm_loadu_si128((const __m128i *)&arr[i + 12]), 24);
+		const __m128i lo = _mm_packs_epi32(a, b);
+		const __m128i hi = _mm_packs_epi32(c, d);
+		_mm_storeu_si128((__m128i *)&idx[i], _mm_packus_epi16(lo, hi));
+	}
+	return i;
+}
+
+#endif /* SIMD_X86 */
+
+//-----------------------------------------------------
+void simd_pix_averages(const uint32_t arr[], uint32_t key[], const int n){
+	int i = 0;
+#ifdef SIMD_X86
+	i = simd_has_avx2() ? simd_pix_averages_avx2(arr, key, n) : simd_pix_averages_sse2(arr, key, n);
+#endif
+	for(; i < n; i++){
+		key[i] = simd_average(&arr[i]);
+	}
+}
+
+//-----------------------------------------------------
+void simd_row_build(const uint32_t arr[], uint32_t row[], const int n){
+	int i = 0;
+#ifdef SIMD_X86
+	i = simd_has_avx2() ? simd_row_build_avx2(arr, row, n) : simd_row_build_sse2(arr, row, n);
+#endif
+	for(; i < n; i++){
+		row[i] = arr[i];
+		((uint8_t *)&row[i])[3] = 0;
+	}
+}
+
+//-----------------------------------------------------
+void simd_row_indices(const uint32_t arr[], uint8_t idx[], const int n){
+	int i = 0;
+#ifdef SIMD_X86
+	i = simd_row_indices_sse2(arr, idx, n);
+#endif
+	for(; i < n; i++){
+		idx[i] = ((const uint8_t *)&arr[i])[3];
+	}
+}
+
+//-----------------------------------------------------
+void simd_rows_replicate(void *buf, const size_t row_len, const int rows){
+	uint8_t * const p = buf;
+	const size_t total = row_len * (size_t)(rows > 0 ? rows : 0);
+	size_t filled = row_len;
+	while(filled < total){
+		const size_t len = filled < total - filled ? filled : total - filled;
+		memcpy(&p[filled], p, len);
+		filled += len;
+	}
+}
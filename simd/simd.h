@@ -0,0 +1,54 @@
+//
+//  simd.h
+//  Visualiser
+//
+//  The per-pixel loops which run on every frame, vectorised. SSE2 is always there on
+//  x86-64 so it's used directly, AVX2 is picked at runtime if the CPU has it, and
+//  everything else gets the plain loops.
+//
+
+#ifndef simd_h
+#define simd_h
+
+#include <stdint.h>
+#include <stddef.h>
+
+//-----------------------------------------------------
+/**
+ Work out the sort key of every pixel, the same as ppm_pix_get_average
+
+ @param arr The pixels, as pixel_t rgbeol values
+ @param key Where the keys go
+ @param n The length of both
+ */
+void	simd_pix_averages(const uint32_t arr[], uint32_t key[], const int n);
+
+/**
+ Copy pixels into a frame row with their eol bytes cleared
+
+ @param arr The pixels, as pixel_t rgbeol values
+ @param row Where they go
+ @param n The length of both
+ */
+void	simd_row_build(const uint32_t arr[], uint32_t row[], const int n);
+
+/**
+ Pull the palette index each pixel carries in its eol byte out into a row of indices
+
+ @param arr The tagged pixels
+ @param idx Where the indices go
+ @param n The length of both
+ */
+void	simd_row_indices(const uint32_t arr[], uint8_t idx[], const int n);
+
+/**
+ Copy the first row of a buffer down the rest of it. Each copy doubles what's been
+ filled, so it's a handful of big memcpys however tall the strip is.
+
+ @param buf The buffer, with the first row filled in
+ @param row_len The length of a row in bytes
+ @param rows How many rows there are altogether
+ */
+void	simd_rows_replicate(void *buf, const size_t row_len, const int rows);
+
+#endif /* simd_h */
@@ -0,0 +1,114 @@
+//
+//  sink.c
+//  Visualiser
+//
+
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/types.h>
+
+#include "sink.h"
+
+#define SINK_BUFF_LEN						(64 * 1024)	///< A callback gets bytes in lots of about this many
+
+//-----------------------------------------------------
+static void sink_clear(struct sink * const s, const enum sink_kind kind){
+	memset(s, 0, sizeof(*s));
+	s->kind = kind;
+	s->fd = -1;
+}
+
+//-----------------------------------------------------
+void sink_path(struct sink * const s, const char * const path){
+	sink_clear(s, SINK_PATH);
+	s->path = path;
+}
+
+//-----------------------------------------------------
+void sink_fd(struct sink * const s, const int fd){
+	sink_clear(s, SINK_FD);
+	s->fd = fd;
+}
+
+//-----------------------------------------------------
+void sink_memory(struct sink * const s){
+	sink_clear(s, SINK_MEMORY);
+}
+
+//-----------------------------------------------------
+void sink_callback(struct sink * const s, sink_write_fn write, void *user){
+	sink_clear(s, SINK_CALLBACK);
+	s->write = write;
+	s->user = user;
+}
+
+//-----------------------------------------------------
+/// Hand what the stream has buffered up to the callback
+#ifdef __APPLE__
+static int sink_cookie_write(void *cookie, const char *buf, int size){
+#else
+static ssize_t sink_cookie_write(void *cookie, const char *buf, size_t size){
+#endif
+	struct sink * const s = cookie;
+	if(s->failed || !s->write(s->user, (const uint8_t *)buf, (size_t)size)){
+		s->failed = true;
+		return -1;
+	}
+	return size;
+}
+
+//-----------------------------------------------------
+/// A stream which calls back rather than writing anywhere
+static FILE *sink_cookie_open(struct sink * const s){
+#ifdef __APPLE__
+	return funopen(s, NULL, sink_cookie_write, NULL, NULL);
+#else
+	const cookie_io_functions_t io = { .write = sink_cookie_write };
+	return fopencookie(s, "w", io);
+#endif
+}
+
+//-----------------------------------------------------
+FILE *sink_open(struct sink * const s){
+
+	FILE *fp = NULL;
+	switch(s->kind){
+		case SINK_PATH:
+			fp = fopen(s->path, "wb");
+			break;
+		case SINK_FD:{
+			// The stream closes its own copy, so the caller's stays open
+			const int fd = dup(s->fd);
+			if(-1 != fd){
+				fp = fdopen(fd, "wb");
+				if(!fp){ close(fd); }
+			}
+			break;
+		}
+		case SINK_MEMORY:
+			free(s->data);
+			s->data = NULL;
+			s->len = 0;
+			fp = open_memstream(&s->data, &s->len);
+			break;
+		case SINK_CALLBACK:
+			s->failed = false;
+			fp = sink_cookie_open(s);
+			if(fp){ setvbuf(fp, NULL, _IOFBF, SINK_BUFF_LEN); }
+			break;
+	}
+	if(!fp){
+		perror("Error opening the output\n");
+	}
+	return fp;
+}
+
+//-----------------------------------------------------
+void sink_free(struct sink * const s){
+	if(SINK_MEMORY == s->kind){ free(s->data); }
+	s->data = NULL;
+	s->len = 0;
+}
@@ -0,0 +1,101 @@
+//
+//  sink.h
+//  Visualiser
+//
+//  Where the bytes of an animation end up. That's a named file, a descriptor
+//  which is already open like a socket or a pipe, a buffer in memory which grows
+//  as it's written, or a function that's handed each lot of bytes as they come.
+//  Whichever it is, the writers only ever see the FILE * from sink_open, and
+//  closing that is what finishes the sink off.
+//
+
+#ifndef sink_h
+#define sink_h
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stddef.h>
+
+/// What kind of sink it is
+enum sink_kind{
+	SINK_PATH = 0,		///< A file, made or truncated
+	SINK_FD,			///< A descriptor the caller opened, and still owns once it's done
+	SINK_MEMORY,		///< A buffer, which is there to read once the writer has closed it
+	SINK_CALLBACK		///< A function, which gets the bytes as the writer lets them go
+};
+
+/**
+ Takes some bytes from a callback sink
+
+ @param user Whatever was given to sink_callback
+ @param data The bytes
+ @param len How many
+ @return False to stop, the writer then fails
+ */
+typedef bool (*sink_write_fn)(void *user, const uint8_t data[], const size_t len);
+
+/**
+ Where the output goes
+ */
+struct sink{
+	enum sink_kind	kind;
+	const char		*path;			///< SINK_PATH's file
+	int				fd;				///< SINK_FD's descriptor
+	sink_write_fn	write;			///< SINK_CALLBACK's function
+	void			*user;			///< And what it gets given
+	char			*data;			///< What SINK_MEMORY was given, valid once the writer is done with it
+	size_t			len;			///< How much of it there is
+	bool			failed;			///< SINK_CALLBACK's function said to stop
+};
+
+//-----------------------------------------------------
+/**
+ A sink that writes a file
+
+ @param s The sink
+ @param path The file, which is truncated if it's there already
+ */
+void	sink_path(struct sink * const s, const char * const path);
+
+/**
+ A sink that writes to a descriptor, which stays open afterwards
+
+ @param s The sink
+ @param fd The descriptor
+ */
+void	sink_fd(struct sink * const s, const int fd);
+
+/**
+ A sink that fills a buffer in memory, data and len, which sink_free frees
+
+ @param s The sink
+ */
+void	sink_memory(struct sink * const s);
+
+/**
+ A sink that hands the bytes to a function, a buffer at a time
+
+ @param s The sink
+ @param write The function
+ @param user What it gets given along with them
+ */
+void	sink_callback(struct sink * const s, sink_write_fn write, void *user);
+
+/**
+ Open the sink as a stream for a writer, which closes it when it's done. It can be
+ opened more than once, a memory sink then only keeps the last.
+
+ @param s The sink
+ @return The stream, or NULL if it couldn't be opened
+ */
+FILE	*sink_open(struct sink * const s);
+
+/**
+ Free what a memory sink was given
+
+ @param s The sink
+ */
+void	sink_free(struct sink * const s);
+
+#endif /* sink_h */
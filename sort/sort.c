@@ -0,0 +1,155 @@
+//
+//  sort.c
+//  Visualiser
+//
+
+#include <stdio.h>
+#include <assert.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "sort.h"
+#include "simd.h"
+#include "pmerge.h"
+#include "race.h"
+
+_Thread_local struct trace          *trace_out = NULL;
+_Thread_local struct sort_counters  sort_counts;
+_Thread_local struct radix          radix_engine;
+int                     sort_threads = 0;
+
+/// Fills in a sorter with each order's copy of a function from sort_kernel.h
+#define SORTER(name, fn)    { name, { fn##_gt, fn##_lt, fn##_gt_traced } }
+
+/// The available sorting functions
+struct sorter sorters[] = {
+    SORTER("merge", merge_sort_wrapper),
+    SORTER("bumerge", merge_sort_bu),
+    SORTER("bubble", bubble_sort),
+    SORTER("selection", selctn_sort),
+    SORTER("heap", heap_sort),
+    SORTER("heap4", heap4_sort),
+    SORTER("heap8", heap8_sort),
+    SORTER("intro", intro_sort),
+    SORTER("pdq", pdq_sort),
+    SORTER("tim", tim_sort),
+    SORTER("shell", shell_sort),
+    { "pmerge", { pmerge_sort_asc, pmerge_sort_desc, pmerge_sort_asc } },
+    { "radix", { radix_sort, radix_sort, radix_sort } },
+    SORTER("all", all_sort),
+};
+
+const size_t sorter_count = sizeof(sorters)/sizeof(*sorters);
+
+//-----------------------------------------------------
+int sort_lanes(const int sorter){
+    return sorters[sorter].perform[SORT_ASCENDING] == &all_sort_gt ? (int)sorter_count - 1 : 1;
+}
+
+//-----------------------------------------------------
+void *alloc_aligned(const size_t bytes){
+    const size_t len = ((bytes + CACHE_LINE_LEN - 1) / CACHE_LINE_LEN) * CACHE_LINE_LEN;
+    void *p = aligned_alloc(CACHE_LINE_LEN, len ? len : CACHE_LINE_LEN);
+    if(p){ memset(p, 0, len); }
+    return p;
+}
+
+//-----------------------------------------------------
+uint32_t *sort_keys(const uint32_t arr[], const int n){
+    uint32_t *key = alloc_aligned((size_t)n * sizeof(*key));
+    assert(key);
+    simd_pix_averages(arr, key, n);
+    return key;
+}
+
+//-----------------------------------------------------
+void radix_sort_pass(const uint32_t arr[], const uint32_t key[], const int n, void *ctx){
+	const gif_cb * const cb = ctx;
+	sort_counts.writes += n;
+	if(trace_out){
+		for(int i = 0; i < n; i++){ trace_write(trace_out, (uint32_t)i, arr[i]); }
+	}
+	if(*cb != NULL) { (*cb)(arr, n); }
+}
+
+//-----------------------------------------------------
+void radix_sort(uint32_t arr[], const int n, gif_cb cb)
+{
+    if(cb != NULL) { cb(arr, n); }
+
+	uint32_t *key = sort_keys(arr, n);
+
+	// A frame per digit, straight out of whichever buffer the pass scattered into
+	if(!radix_sort_keys(&radix_engine, arr, key, n, radix_sort_pass, &cb)){
+		fprintf(stderr, "[%d] Radix sort failed, the array is untouched\n", __LINE__);
+	}
+
+	free(key);
+}
+
+//-----------------------------------------------------
+void pmerge_sort_level(const uint32_t arr[], const uint32_t key[], const int n, const int lo, const int hi, const unsigned long compares, const unsigned long writes, void *ctx){
+	const gif_cb * const cb = ctx;
+	sort_counts.compares += compares;
+	sort_counts.writes += writes;
+	// The threads can't share the trace, so the slice goes in as one lot of writes
+	if(trace_out){
+		for(int i = lo; i < hi; i++){ trace_write(trace_out, (uint32_t)i, arr[i]); }
+	}
+	if(*cb != NULL) { (*cb)(arr, n); }
+}
+
+//-----------------------------------------------------
+static void pmerge_sort_order(uint32_t arr[], const int n, gif_cb cb, const bool descending){
+	uint32_t *key = sort_keys(arr, n);
+	if(!pmerge_sort(arr, key, n, sort_threads, descending, NULL != cb, pmerge_sort_level, &cb)){
+		fprintf(stderr, "[%d] Parallel merge sort failed, the array is untouched\n", __LINE__);
+	}
+	free(key);
+}
+
+//-----------------------------------------------------
+void pmerge_sort_asc(uint32_t arr[], const int n, gif_cb cb){
+	pmerge_sort_order(arr, n, cb, false);
+}
+
+//-----------------------------------------------------
+void pmerge_sort_desc(uint32_t arr[], const int n, gif_cb cb){
+	pmerge_sort_order(arr, n, cb, true);
+}
+
+//-----------------------------------------------------
+void swap(uint32_t * const xp, uint32_t * const yp){
+	uint32_t temp = *xp;
+	*xp = *yp;
+	*yp = temp;
+	sort_counts.swaps++;
+	if(trace_out) { trace_swap(trace_out, (uint32_t)(xp - trace_out->arr), (uint32_t)(yp - trace_out->arr)); }
+}
+
+//-----------------------------------------------------
+void swap_keyed(uint32_t arr[], uint32_t key[], const int a, const int b){
+	swap(&arr[a], &arr[b]);
+	uint32_t temp = key[a];
+	key[a] = key[b];
+	key[b] = temp;
+}
+
+//-----------------------------------------------------
+// The comparison sorts themselves, see sort_kernel.h
+#define SORT_KERNEL_BODIES
+
+#define SORT_SUFFIX         gt
+#define SORT_ORDER          SORT_ASCENDING
+#define SORT_TEST           SORT_TEST_GT
+#include "sort_kernel.h"
+
+#define SORT_SUFFIX         lt
+#define SORT_ORDER          SORT_DESCENDING
+#define SORT_TEST           SORT_TEST_LT
+#include "sort_kernel.h"
+
+#define SORT_SUFFIX         gt_traced
+#define SORT_ORDER          SORT_ASCENDING_TRACED
+#define SORT_TEST           SORT_TEST_GT_TRACED
+#include "sort_kernel.h"
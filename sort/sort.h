@@ -0,0 +1,192 @@
+//
+//  sort.h
+//  Visualiser
+//
+//  The sorting algorithms and the table main picks them from. They report what they
+//  do through sort_counts and trace_out, and hand frames to a gif_cb as they go.
+//
+
+#ifndef sort_h
+#define sort_h
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+#include "ppm.h"
+#include "trace.h"
+#include "radix.h"
+
+#define CACHE_LINE_LEN                      64
+#define SORT_INSERTION_LEN                  16      ///< Introsort leaves parts this short to insertion sort
+#define SORT_PDQ_INSERTION_LEN              24      ///< The same for pdqsort
+#define SORT_PDQ_NINTHER_LEN                128     ///< Parts longer than this take their pivot from nine elements rather than three
+#define SORT_PDQ_PARTIAL_LIMIT              8       ///< Elements pdqsort will move to finish a part that looks sorted before giving up
+#define SORT_TIM_MIN_GALLOP                 7       ///< Wins in a row before timsort's merge starts galloping
+#define SORT_TIM_STACK_LEN                  85      ///< Runs waiting to merge, enough for any int length
+#define SORT_SHELL_PASS_FRAMES              16      ///< Frames within each gap's pass, at most, besides the one at the end
+
+/// Where the sorts send each frame
+typedef void (*gif_cb)(const uint32_t arr[], const int n);
+
+/// Which way round to sort. Each one gets its own copy of the comparison sorts,
+/// so the compare is inlined instead of being a call in the inner loop.
+enum sort_order{
+    SORT_ASCENDING = 0,         ///< Smallest key first
+    SORT_DESCENDING,            ///< Largest key first
+    SORT_ASCENDING_TRACED,      ///< Smallest key first, and every compare goes in the trace
+    SORT_ORDERS                 ///< How many there are
+};
+
+/// The compares for each order, every one is counted
+#define SORT_TEST_GT(a, b)          (sort_counts.compares++, (a) > (b))
+#define SORT_TEST_LT(a, b)          (sort_counts.compares++, (a) < (b))
+#define SORT_TEST_GT_TRACED(a, b)   (trace_compare(trace_out), sort_counts.compares++, (a) > (b))
+
+/**
+ What the sorts have done so far, reset it before a sort to count just that one
+ */
+struct sort_counters{
+    unsigned long   compares;       ///< Keys compared
+    unsigned long   swaps;          ///< Pairs of elements exchanged
+    unsigned long   writes;         ///< Single elements written, by the merges and the radix passes
+};
+
+typedef void (*sort_fn)(uint32_t arr[], const int n, gif_cb cb);
+
+/**
+ Swaps two variables contents
+ 
+ @param xp A, will have B
+ @param yp B, will have A
+ */
+void	swap(uint32_t * const xp, uint32_t * const yp);
+
+/**
+ Swaps two elements and their keys
+
+ @param arr The array
+ @param key The keys that go with it
+ @param a One index
+ @param b The other
+ */
+void	swap_keyed(uint32_t arr[], uint32_t key[], const int a, const int b);
+
+/**
+ Work out every element's key once, so the sorts compare those instead of
+ averaging the pixels again on every comparison. The sorts move them in step.
+
+ @param arr The array
+ @param n Its length
+ @return The keys, free them when done
+ */
+uint32_t *sort_keys(const uint32_t arr[], const int n);
+
+/**
+ Do an LSD radix sort on the keys, a digit of radix_engine.bits at a time
+
+ @param arr The array to sort
+ @param n It's length
+ @param cb The callback to the function which actually writes it to the gif
+ */
+void	radix_sort(uint32_t arr[], const int n, gif_cb cb);
+
+/**
+ Reports a radix scatter pass, the same as the other sorts report their writes
+
+ @param arr Where the array is now, which might be the radix scratch buffer
+ @param key The keys that go with it
+ @param n The length of it
+ @param ctx The gif_cb to give the frame to
+ */
+void	radix_sort_pass(const uint32_t arr[], const uint32_t key[], const int n, void *ctx);
+
+/**
+ Merge sort where each level is merged on sort_threads threads, with a frame between levels
+
+ @param arr The array to sort
+ @param n The length of it
+ @param cb The callback to the function which actually writes it to the gif
+ */
+void	pmerge_sort_asc(uint32_t arr[], const int n, gif_cb cb);
+
+/**
+ The same but largest first
+
+ @param arr The array to sort
+ @param n The length of it
+ @param cb The callback to the function which actually writes it to the gif
+ */
+void	pmerge_sort_desc(uint32_t arr[], const int n, gif_cb cb);
+
+/**
+ Reports a slice of a finished merge level, the same as the other sorts report their writes
+
+ @param arr The whole array, with the level done up to the end of the slice
+ @param key The keys that go with it
+ @param n The length of it
+ @param lo Where the slice starts
+ @param hi And where it ends, one past
+ @param compares The compares it took
+ @param writes The elements it wrote
+ @param ctx The gif_cb to give the frame to
+ */
+void	pmerge_sort_level(const uint32_t arr[], const uint32_t key[], const int n, const int lo, const int hi, const unsigned long compares, const unsigned long writes, void *ctx);
+
+#define SORT_SUFFIX         gt
+#define SORT_ORDER          SORT_ASCENDING
+#define SORT_TEST           SORT_TEST_GT
+#include "sort_kernel.h"
+
+#define SORT_SUFFIX         lt
+#define SORT_ORDER          SORT_DESCENDING
+#define SORT_TEST           SORT_TEST_LT
+#include "sort_kernel.h"
+
+#define SORT_SUFFIX         gt_traced
+#define SORT_ORDER          SORT_ASCENDING_TRACED
+#define SORT_TEST           SORT_TEST_GT_TRACED
+#include "sort_kernel.h"
+
+/// A sorting algo
+struct sorter{
+    char name[PPM_FILEPATH_BUFF_LEN]; ///< The description used at the command line
+    sort_fn perform[SORT_ORDERS];     ///< The actual sort function, for each enum sort_order
+};
+
+extern struct sorter    sorters[];                  ///< The available sorting functions, "all" is last
+extern const size_t     sorter_count;               ///< How many there are
+// Each thread gets its own of these, so sorts can run side by side. A thread has to
+// radix_init its radix_engine before it runs the radix sort.
+extern _Thread_local struct trace           *trace_out;     ///< Set while recording, the sorts report what they do to it
+extern _Thread_local struct sort_counters   sort_counts;    ///< Swaps, writes and compares done so far
+extern _Thread_local struct radix           radix_engine;   ///< Keeps its buffers between radix sorts
+extern int              sort_threads;               ///< For the sorts which can use more than one, 0 for one per core
+
+/**
+ Allocate zeroed memory which starts on a cache line
+
+ @param bytes How much
+ @return The memory, free it with free(), or NULL
+ */
+void    *alloc_aligned(const size_t bytes);
+
+/**
+ How many strips each of the sorter's frames is made of. The race's frames are every
+ lane's array one after the other, everything else's are just the array.
+
+ @param sorter Index in sorters
+ @return The number of strips, each the length of the array
+ */
+int     sort_lanes(const int sorter);
+
+/**
+ Every operation counted so far, which is what the frame budget spreads frames over
+
+ @return Compares, swaps and writes together
+ */
+static inline unsigned long sort_ops(void){
+    return sort_counts.compares + sort_counts.swaps + sort_counts.writes;
+}
+
+#endif /* sort_h */
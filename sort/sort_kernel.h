@@ -0,0 +1,995 @@
+//
+//  sort_kernel.h
+//  Visualiser
+//
+//  The comparison sorts, written once and stamped out for each order so the
+//  compare is inlined rather than called through a pointer in the inner loop.
+//  There's deliberately no include guard, include it once per order with these set:
+//
+//  SORT_SUFFIX			Appended to every function name, eg gt gives bubble_sort_gt
+//  SORT_ORDER			The enum sort_order it is, so all_sort runs the matching ones
+//  SORT_TEST(a, b)		True if key a belongs after key b
+//
+//  The prototypes always come out, the bodies only if SORT_KERNEL_BODIES is defined.
+//  sort.h pulls in the prototypes and sort.c the bodies, which use the rest of sort.h.
+//
+
+#if !defined(SORT_SUFFIX) || !defined(SORT_ORDER) || !defined(SORT_TEST)
+#error "Define SORT_SUFFIX, SORT_ORDER and SORT_TEST before including sort_kernel.h"
+#endif
+
+#define SORT_CAT_(a, b)		a##_##b
+#define SORT_CAT(a, b)		SORT_CAT_(a, b)
+#define SORT_FN(name)		SORT_CAT(name, SORT_SUFFIX)
+
+/**
+ Bubble Sort from http://www.geeksforgeeks.org/bubble-sort/
+
+ @param arr The Array
+ @param n Array Length
+ @param cb The callback to the function which actually writes it to the gif
+ */
+void	SORT_FN(bubble_sort)(uint32_t arr[], const int n, gif_cb cb);
+
+/**
+ Selection Sort from http://www.algolist.net/Algorithms/Sorting/Selection_sort
+
+ @param arr The Array
+ @param n Array Length
+ @param cb The callback to the function which actually writes it to the gif
+ */
+void	SORT_FN(selctn_sort)(uint32_t arr[], const int n, gif_cb cb);
+
+/**
+ Puts the element at i in the correct place in the heap. It's a loop rather than
+ recursion, and the children move up into the hole rather than being swapped.
+
+ @param arr The array
+ @param key The keys that go with it
+ @param n The length of it
+ @param i The thing to place
+ @param d How many children each node has
+ */
+void	SORT_FN(heapify)(uint32_t arr[], uint32_t key[], const int n, int i, const int d);
+
+/**
+ Heap sort with d children per node. The keys are laid out so that every node's
+ children start on a multiple of d, so with 4 or 8 they're all in one cache line.
+
+ @param arr The array to sort
+ @param n The length of it
+ @param cb The callback to the function which actually writes it to the gif
+ @param d How many children each node has
+ */
+void	SORT_FN(heap_sort_d)(uint32_t arr[], const int n, gif_cb cb, const int d);
+
+/**
+ Heap sort from http://www.geeksforgeeks.org/heap-sort/
+
+ @param arr The array to sort
+ @param n The length of it
+ @param cb The callback to the function which actually writes it to the gif
+ */
+void	SORT_FN(heap_sort)(uint32_t arr[], const int n, gif_cb cb);
+
+/**
+ Heap sort with 4 children per node
+
+ @param arr The array to sort
+ @param n The length of it
+ @param cb The callback to the function which actually writes it to the gif
+ */
+void	SORT_FN(heap4_sort)(uint32_t arr[], const int n, gif_cb cb);
+
+/**
+ Heap sort with 8 children per node
+
+ @param arr The array to sort
+ @param n The length of it
+ @param cb The callback to the function which actually writes it to the gif
+ */
+void	SORT_FN(heap8_sort)(uint32_t arr[], const int n, gif_cb cb);
+
+/**
+ Merge the two asubarrays
+
+ @param arr The total array
+ @param key The keys that go with it
+ @param scratch Room for both halves and their keys, twice the length of the array
+ @param l The left
+ @param m The middle
+ @param r The right
+ */
+void	SORT_FN(merge)(uint32_t arr[], uint32_t key[], uint32_t scratch[], int l, int m, int r);
+
+/**
+ Perform the mergesort http://www.geeksforgeeks.org/merge-sort/
+
+ @param arr The array to sort
+ @param key The keys that go with it
+ @param scratch Room for merge to copy the halves to, twice the length of the array
+ @param l The left edge of the array
+ @param r The right edge of the array
+ @param cb The callback to the function which actually writes it to the gif
+ @param arr_len The length of the array
+ */
+void	SORT_FN(merge_sort)(uint32_t arr[], uint32_t key[], uint32_t scratch[], int l, int r, gif_cb cb, const int arr_len);
+
+/**
+ Merge two runs which sit next to each other in src into the same place in dst
+
+ @param src The payload to merge from
+ @param src_key Its keys
+ @param dst Where the merged run goes
+ @param dst_key Its keys
+ @param l Start of the first run
+ @param m Start of the second run
+ @param r One past the end of the second
+ */
+void	SORT_FN(merge_runs)(const uint32_t src[], const uint32_t src_key[], uint32_t dst[], uint32_t dst_key[], const int l, const int m, const int r);
+
+/**
+ Bottom-up merge sort. Each level merges from the array into a scratch buffer or back,
+ rather than copying the runs out and merging them back in, with a frame per level.
+
+ @param arr The array to sort
+ @param n The length of it
+ @param cb The callback to the function which actually writes it to the gif
+ */
+void	SORT_FN(merge_sort_bu)(uint32_t arr[], const int n, gif_cb cb);
+
+/**
+ Merge sort wrapper which allows it to have the same function signature as the rest.
+
+ @param arr The array to sort
+ @param n The length of it
+ @param cb The callback to the function which actually writes it to the gif
+ */
+void	SORT_FN(merge_sort_wrapper)(uint32_t arr[], const int n, gif_cb cb);
+
+/**
+ Introsort: quicksort on a median of three, which turns into heap sort on any part
+ that's recursed too deep, and leaves the short parts to insertion sort
+
+ @param arr The array to sort
+ @param n The length of it
+ @param cb The callback to the function which actually writes it to the gif
+ */
+void	SORT_FN(intro_sort)(uint32_t arr[], const int n, gif_cb cb);
+
+/**
+ Pattern-defeating quicksort https://github.com/orlp/pdqsort. It spots runs which are
+ already in order and equal keys, shuffles when the partitions come out lopsided, and
+ falls back to heap sort if that keeps happening.
+
+ @param arr The array to sort
+ @param n The length of it
+ @param cb The callback to the function which actually writes it to the gif
+ */
+void	SORT_FN(pdq_sort)(uint32_t arr[], const int n, gif_cb cb);
+
+/**
+ Timsort https://github.com/python/cpython/blob/main/Objects/listsort.txt. Finds the runs
+ already in the array, reversing the descending ones and padding the short ones out by
+ insertion, then merges them, galloping through the stretches that come from one side.
+
+ @param arr The array to sort
+ @param n The length of it
+ @param cb The callback to the function which actually writes it to the gif
+ */
+void	SORT_FN(tim_sort)(uint32_t arr[], const int n, gif_cb cb);
+
+/**
+ Shell sort with Ciura's gaps, then more by 2.25 times for arrays longer than those
+
+ @param arr The array to sort
+ @param n The length of it
+ @param cb The callback to the function which actually writes it to the gif
+ */
+void	SORT_FN(shell_sort)(uint32_t arr[], const int n, gif_cb cb);
+
+/**
+ Race every other sort on copies of the array, each frame being all of them one after
+ the other, see sort_lanes. When tracing they take turns on the array instead, since a
+ trace can only follow one.
+
+ @param arr The array to sort
+ @param n The length of it
+ @param cb The callback to the function which actually writes it to the gif
+ */
+void	SORT_FN(all_sort)(uint32_t arr[], const int n, gif_cb cb);
+
+#ifdef SORT_KERNEL_BODIES
+
+//-----------------------------------------------------
+void SORT_FN(bubble_sort)(uint32_t arr[], const int n, gif_cb cb){
+	int i, j;
+	uint32_t *key = sort_keys(arr, n);
+	for (i = 0; i < n-1; i++){
+
+		// Last i elements are already in place
+		for (j = 0; j < n-i-1; j++){
+			if (SORT_TEST(key[j], key[j+1]))
+			{
+				swap_keyed(arr, key, j, j+1);
+			}
+		}
+		if(cb != NULL) { cb(arr, n); }
+	}
+	free(key);
+}
+
+//-----------------------------------------------------
+void SORT_FN(selctn_sort)(uint32_t arr[], const int n, gif_cb cb) {
+	int i, j, minIndex, tmp;
+	uint32_t *key = sort_keys(arr, n);
+	for (i = 0; i < n - 1; i++) {
+		minIndex = i;
+		for (j = i + 1; j < n; j++)
+			if(!SORT_TEST(key[j], key[minIndex]))
+				minIndex = j;
+		if (minIndex != i) {
+			tmp = arr[i];
+			arr[i] = arr[minIndex];
+			arr[minIndex] = tmp;
+			tmp = key[i];
+			key[i] = key[minIndex];
+			key[minIndex] = tmp;
+			sort_counts.swaps++;
+			if(trace_out) { trace_swap(trace_out, i, minIndex); }
+		}
+		if(cb != NULL) { cb(arr, n); }
+	}
+	if(cb != NULL) { cb(arr, n); }
+	free(key);
+}
+
+//-----------------------------------------------------
+void SORT_FN(heapify)(uint32_t arr[], uint32_t key[], const int n, int i, const int d){
+
+	const int start = i;
+	const uint32_t v = arr[i];
+	const uint32_t vk = key[i];
+
+	for(;;){
+		const int first = d * i + 1;
+		if(first >= n){ break; }
+		const int last = first + d < n ? first + d : n;
+
+		// The child which belongs nearest the root
+		int best = first;
+		for(int c = first + 1; c < last; c++){
+			if(SORT_TEST(key[c], key[best])){ best = c; }
+		}
+		if(!SORT_TEST(key[best], vk)){ break; }
+
+		arr[i] = arr[best];
+		key[i] = key[best];
+		sort_counts.writes++;
+		if(trace_out) { trace_write(trace_out, i, arr[i]); }
+		i = best;
+	}
+
+	if(i != start){
+		arr[i] = v;
+		key[i] = vk;
+		sort_counts.writes++;
+		if(trace_out) { trace_write(trace_out, i, arr[i]); }
+	}
+}
+
+//-----------------------------------------------------
+void SORT_FN(heap_sort_d)(uint32_t arr[], const int n, gif_cb cb, const int d)
+{
+	// Start the keys d - 1 in, then the children of i, from d * i + 1, are at a multiple of d
+	uint32_t *pad = alloc_aligned(((size_t)n + d - 1) * sizeof(*pad));
+	assert(pad);
+	uint32_t *key = pad + d - 1;
+	simd_pix_averages(arr, key, n);
+
+	// Build heap (rearrange array)
+	const int last_parent = n > 1 ? (n - 2) / d : -1;
+	for (int i = last_parent; i >= 0; i--){
+		SORT_FN(heapify)(arr, key, n, i, d);
+		if(cb != NULL) { cb(arr, n); }
+	}
+
+	// One by one extract an element from heap
+	for (int i = n - 1; i > 0; i--)
+	{
+		// Move current root to end
+		swap_keyed(arr, key, 0, i);
+
+		// call max heapify on the reduced heap
+		SORT_FN(heapify)(arr, key, i, 0, d);
+
+		if(cb != NULL) { cb(arr, n); }
+	}
+	free(pad);
+}
+
+//-----------------------------------------------------
+void SORT_FN(heap_sort)(uint32_t arr[], const int n, gif_cb cb){
+	SORT_FN(heap_sort_d)(arr, n, cb, 2);
+}
+
+//-----------------------------------------------------
+void SORT_FN(heap4_sort)(uint32_t arr[], const int n, gif_cb cb){
+	SORT_FN(heap_sort_d)(arr, n, cb, 4);
+}
+
+//-----------------------------------------------------
+void SORT_FN(heap8_sort)(uint32_t arr[], const int n, gif_cb cb){
+	SORT_FN(heap_sort_d)(arr, n, cb, 8);
+}
+
+//-----------------------------------------------------
+void SORT_FN(merge)(uint32_t arr[], uint32_t key[], uint32_t scratch[], int l, int m, int r){
+
+	uint32_t i, j, k;
+	uint32_t n1 = m - l + 1;
+	uint32_t n2 =  r - m;
+
+	/* temp arrays in the scratch, the pixels then their keys */
+	uint32_t *L = scratch;
+	uint32_t *R = L + n1;
+	uint32_t *LK = R + n2;
+	uint32_t *RK = LK + n1;
+
+	/* Copy data to temp arrays L[] and R[] */
+	for (i = 0; i < n1; i++){
+		L[i] = arr[l + i];
+		LK[i] = key[l + i];
+	}
+	for (j = 0; j < n2; j++){
+		R[j] = arr[m + 1+ j];
+		RK[j] = key[m + 1+ j];
+	}
+
+	/* Merge the temp arrays back into arr[l..r]*/
+	i = 0; // Initial index of first subarray
+	j = 0; // Initial index of second subarray
+	k = l; // Initial index of merged subarray
+	while (i < n1 && j < n2)
+	{
+		if (!SORT_TEST(LK[i], RK[j]))
+		{
+			arr[k] = L[i];
+			key[k] = LK[i];
+			i++;
+		}
+		else
+		{
+			arr[k] = R[j];
+			key[k] = RK[j];
+			j++;
+		}
+		sort_counts.writes++;
+		if(trace_out) { trace_write(trace_out, k, arr[k]); }
+		k++;
+	}
+
+	/* Copy the remaining elements of L[], if there
+	 are any */
+	while (i < n1)
+	{
+		arr[k] = L[i];
+		key[k] = LK[i];
+		sort_counts.writes++;
+		if(trace_out) { trace_write(trace_out, k, arr[k]); }
+		i++;
+		k++;
+	}
+
+	/* Copy the remaining elements of R[], if there
+	 are any */
+	while (j < n2)
+	{
+		arr[k] = R[j];
+		key[k] = RK[j];
+		sort_counts.writes++;
+		if(trace_out) { trace_write(trace_out, k, arr[k]); }
+		j++;
+		k++;
+	}
+}
+
+//-----------------------------------------------------
+void SORT_FN(merge_sort)(uint32_t arr[], uint32_t key[], uint32_t scratch[], int l, int r, gif_cb cb, const int arr_len){
+
+	if (l < r)
+	{
+		// Same as (l+r)/2, but avoids overflow for
+		// large l and h
+		int m = l+(r-l)/2;
+
+		// Sort first and second halves
+		SORT_FN(merge_sort)(arr, key, scratch, l, m, cb, arr_len);
+		SORT_FN(merge_sort)(arr, key, scratch, m+1, r, cb, arr_len);
+		SORT_FN(merge)(arr, key, scratch, l, m, r);
+		if(cb != NULL) { cb(arr, arr_len); }
+
+	}
+
+}
+
+//-----------------------------------------------------
+void SORT_FN(merge_sort_wrapper)(uint32_t arr[], const int n, gif_cb cb){
+	uint32_t *key = sort_keys(arr, n);
+	uint32_t *scratch = alloc_aligned((size_t)n * 2 * sizeof(*scratch));
+	assert(scratch);
+	SORT_FN(merge_sort)(arr, key, scratch, 0, n-1, cb, n);
+	free(scratch);
+	free(key);
+}
+
+//-----------------------------------------------------
+void SORT_FN(merge_runs)(const uint32_t src[], const uint32_t src_key[], uint32_t dst[], uint32_t dst_key[], const int l, const int m, const int r){
+	int i = l, j = m, k = l;
+	while(i < m && j < r){
+		if(!SORT_TEST(src_key[i], src_key[j])){
+			dst[k] = src[i];
+			dst_key[k++] = src_key[i++];
+		}
+		else{
+			dst[k] = src[j];
+			dst_key[k++] = src_key[j++];
+		}
+	}
+
+	// Whichever run is left over goes on the end as it is
+	memcpy(&dst[k], &src[i], (m - i) * sizeof(*dst));
+	memcpy(&dst_key[k], &src_key[i], (m - i) * sizeof(*dst_key));
+	k += m - i;
+	memcpy(&dst[k], &src[j], (r - j) * sizeof(*dst));
+	memcpy(&dst_key[k], &src_key[j], (r - j) * sizeof(*dst_key));
+
+	sort_counts.writes += r - l;
+	if(trace_out){
+		for(k = l; k < r; k++){ trace_write(trace_out, k, dst[k]); }
+	}
+}
+
+//-----------------------------------------------------
+void SORT_FN(merge_sort_bu)(uint32_t arr[], const int n, gif_cb cb){
+	if(n < 2){ return; }
+
+	uint32_t *key = sort_keys(arr, n);
+	uint32_t *scratch = alloc_aligned((size_t)n * 2 * sizeof(*scratch));
+	assert(scratch);
+	uint32_t *src = arr, *src_key = key, *dst = scratch, *dst_key = scratch + n;
+
+	// An odd number of levels would finish in the scratch, so then the pairs
+	// are put in order where they are first and the merging starts at 2
+	int levels = 0;
+	for(int width = 1; width < n; width *= 2){ levels++; }
+	int width = 1;
+	if(levels % 2){
+		for(int i = 0; i + 1 < n; i += 2){
+			if(SORT_TEST(key[i], key[i+1])){ swap_keyed(arr, key, i, i+1); }
+		}
+		if(cb != NULL) { cb(arr, n); }
+		width = 2;
+	}
+
+	for(; width < n; width *= 2){
+		for(int l = 0; l < n; l += 2 * width){
+			const int m = l + width < n ? l + width : n;
+			const int r = l + 2 * width < n ? l + 2 * width : n;
+			SORT_FN(merge_runs)(src, src_key, dst, dst_key, l, m, r);
+		}
+		if(cb != NULL) { cb(dst, n); }
+
+		uint32_t *tmp = src; src = dst; dst = tmp;
+		tmp = src_key; src_key = dst_key; dst_key = tmp;
+	}
+
+	free(scratch);
+	free(key);
+}
+
+//-----------------------------------------------------
+/// Put an element and its key at i, counting it as a write
+static inline void SORT_FN(put)(uint32_t arr[], uint32_t key[], const int i, const uint32_t v, const uint32_t vk){
+	arr[i] = v;
+	key[i] = vk;
+	sort_counts.writes++;
+	if(trace_out) { trace_write(trace_out, i, v); }
+}
+
+//-----------------------------------------------------
+/// Insertion sort of lo to hi, where lo up to start is already in order
+static void SORT_FN(insertion_range)(uint32_t arr[], uint32_t key[], const int lo, const int hi, const int start){
+	for(int i = start > lo ? start : lo + 1; i < hi; i++){
+		const uint32_t v = arr[i];
+		const uint32_t vk = key[i];
+		int j = i;
+		for(; j > lo && SORT_TEST(key[j-1], vk); j--){
+			SORT_FN(put)(arr, key, j, arr[j-1], key[j-1]);
+		}
+		if(j != i){ SORT_FN(put)(arr, key, j, v, vk); }
+	}
+}
+
+//-----------------------------------------------------
+/// Put a, b and c in order
+static inline void SORT_FN(sort3)(uint32_t arr[], uint32_t key[], const int a, const int b, const int c){
+	if(SORT_TEST(key[a], key[b])){ swap_keyed(arr, key, a, b); }
+	if(SORT_TEST(key[b], key[c])){ swap_keyed(arr, key, b, c); }
+	if(SORT_TEST(key[a], key[b])){ swap_keyed(arr, key, a, b); }
+}
+
+//-----------------------------------------------------
+/// Heap sort lo to hi, for when the partitions keep coming out lopsided
+static void SORT_FN(heap_range)(uint32_t arr[], uint32_t key[], const int lo, const int hi){
+	const int n = hi - lo;
+	for(int end = n, start = n / 2 - 1; end > 1; ){
+		// Build the heap first, then take the root off the end each time
+		int i;
+		if(start >= 0){ i = start--; }
+		else{
+			swap_keyed(arr, key, lo, lo + --end);
+			i = 0;
+		}
+		for(int c = 2 * i + 1; c < end; c = 2 * i + 1){
+			if(c + 1 < end && SORT_TEST(key[lo+c+1], key[lo+c])){ c++; }
+			if(!SORT_TEST(key[lo+c], key[lo+i])){ break; }
+			swap_keyed(arr, key, lo + i, lo + c);
+			i = c;
+		}
+	}
+}
+
+//-----------------------------------------------------
+/// Partition begin to end around the pivot at begin, with the keys equal to it going right.
+/// There has to be a key that doesn't go before the pivot at the end, which the median of three sees to.
+/// @return Where the pivot ended up, and whether nothing needed to move
+static int SORT_FN(partition_right)(uint32_t arr[], uint32_t key[], const int begin, const int end, bool * const already){
+	const uint32_t pk = key[begin];
+	int first = begin, last = end;
+
+	do{ first++; } while(SORT_TEST(pk, key[first]));
+	if(first - 1 == begin){
+		// Nothing went before the pivot, so the scan down has to watch for meeting it
+		while(first < last){
+			last--;
+			if(SORT_TEST(pk, key[last])){ break; }
+		}
+	}
+	else{
+		do{ last--; } while(!SORT_TEST(pk, key[last]));
+	}
+
+	*already = first >= last;
+	while(first < last){
+		swap_keyed(arr, key, first, last);
+		do{ first++; } while(SORT_TEST(pk, key[first]));
+		do{ last--; } while(!SORT_TEST(pk, key[last]));
+	}
+
+	const int pivot = first - 1;
+	if(pivot != begin){ swap_keyed(arr, key, begin, pivot); }
+	return pivot;
+}
+
+//-----------------------------------------------------
+/// Partition with the keys equal to the pivot going left. The element before begin has
+/// a key equal to the pivot's, so everything equal is finished with in one go.
+/// @return Where the pivot ended up
+static int SORT_FN(partition_left)(uint32_t arr[], uint32_t key[], const int begin, const int end){
+	const uint32_t pk = key[begin];
+	int first = begin, last = end;
+
+	do{ last--; } while(SORT_TEST(key[last], pk));
+	if(last + 1 == end){
+		while(first < last){
+			first++;
+			if(SORT_TEST(key[first], pk)){ break; }
+		}
+	}
+	else{
+		do{ first++; } while(!SORT_TEST(key[first], pk));
+	}
+
+	while(first < last){
+		swap_keyed(arr, key, first, last);
+		do{ last--; } while(SORT_TEST(key[last], pk));
+		do{ first++; } while(!SORT_TEST(key[first], pk));
+	}
+
+	if(last != begin){ swap_keyed(arr, key, begin, last); }
+	return last;
+}
+
+//-----------------------------------------------------
+/// Insertion sort which gives up once it's moved more than SORT_PDQ_PARTIAL_LIMIT elements
+/// @return Whether it finished
+static bool SORT_FN(partial_insertion)(uint32_t arr[], uint32_t key[], const int begin, const int end){
+	int moved = 0;
+	for(int i = begin + 1; i < end; i++){
+		if(moved > SORT_PDQ_PARTIAL_LIMIT){ return false; }
+		if(!SORT_TEST(key[i-1], key[i])){ continue; }
+
+		const uint32_t v = arr[i];
+		const uint32_t vk = key[i];
+		int j = i;
+		do{
+			SORT_FN(put)(arr, key, j, arr[j-1], key[j-1]);
+			j--;
+		} while(j > begin && SORT_TEST(key[j-1], vk));
+		SORT_FN(put)(arr, key, j, v, vk);
+		moved += i - j;
+	}
+	return true;
+}
+
+//-----------------------------------------------------
+/// Recurse into the smaller side and loop on the bigger, so the stack stays shallow
+static void SORT_FN(intro_loop)(uint32_t arr[], uint32_t key[], int lo, int hi, int depth, gif_cb cb, const int n){
+	while(hi - lo > SORT_INSERTION_LEN){
+		if(0 == depth--){
+			SORT_FN(heap_range)(arr, key, lo, hi);
+			if(cb != NULL) { cb(arr, n); }
+			return;
+		}
+
+		bool already;
+		SORT_FN(sort3)(arr, key, lo + (hi - lo) / 2, lo, hi - 1);
+		const int p = SORT_FN(partition_right)(arr, key, lo, hi, &already);
+		if(cb != NULL) { cb(arr, n); }
+
+		if(p - lo < hi - p - 1){
+			SORT_FN(intro_loop)(arr, key, lo, p, depth, cb, n);
+			lo = p + 1;
+		}
+		else{
+			SORT_FN(intro_loop)(arr, key, p + 1, hi, depth, cb, n);
+			hi = p;
+		}
+	}
+	SORT_FN(insertion_range)(arr, key, lo, hi, lo + 1);
+	if(cb != NULL) { cb(arr, n); }
+}
+
+//-----------------------------------------------------
+void SORT_FN(intro_sort)(uint32_t arr[], const int n, gif_cb cb){
+	uint32_t *key = sort_keys(arr, n);
+	int depth = 0;
+	for(int i = n; i > 1; i /= 2){ depth += 2; }
+	SORT_FN(intro_loop)(arr, key, 0, n, depth, cb, n);
+	free(key);
+}
+
+//-----------------------------------------------------
+/// Swap a few elements from each quarter in, so the next pivot is unlikely to be as bad
+static void SORT_FN(pdq_shuffle)(uint32_t arr[], uint32_t key[], const int begin, const int pivot, const int end){
+	const int l_size = pivot - begin;
+	const int r_size = end - (pivot + 1);
+	if(l_size >= SORT_PDQ_INSERTION_LEN){
+		swap_keyed(arr, key, begin, begin + l_size / 4);
+		swap_keyed(arr, key, pivot - 1, pivot - l_size / 4);
+		if(l_size > SORT_PDQ_NINTHER_LEN){
+			swap_keyed(arr, key, begin + 1, begin + (l_size / 4 + 1));
+			swap_keyed(arr, key, begin + 2, begin + (l_size / 4 + 2));
+			swap_keyed(arr, key, pivot - 2, pivot - (l_size / 4 + 1));
+			swap_keyed(arr, key, pivot - 3, pivot - (l_size / 4 + 2));
+		}
+	}
+	if(r_size >= SORT_PDQ_INSERTION_LEN){
+		swap_keyed(arr, key, pivot + 1, pivot + (1 + r_size / 4));
+		swap_keyed(arr, key, end - 1, end - r_size / 4);
+		if(r_size > SORT_PDQ_NINTHER_LEN){
+			swap_keyed(arr, key, pivot + 2, pivot + (2 + r_size / 4));
+			swap_keyed(arr, key, pivot + 3, pivot + (3 + r_size / 4));
+			swap_keyed(arr, key, end - 2, end - (1 + r_size / 4));
+			swap_keyed(arr, key, end - 3, end - (2 + r_size / 4));
+		}
+	}
+}
+
+//-----------------------------------------------------
+/// Sort begin to end. leftmost is set if there's nothing before begin which is still in play.
+static void SORT_FN(pdq_loop)(uint32_t arr[], uint32_t key[], int begin, const int end, int bad_allowed, bool leftmost, gif_cb cb, const int n){
+	for(;;){
+		const int size = end - begin;
+		if(size < SORT_PDQ_INSERTION_LEN){
+			SORT_FN(insertion_range)(arr, key, begin, end, begin + 1);
+			if(cb != NULL) { cb(arr, n); }
+			return;
+		}
+
+		// The pivot goes to begin, as the median of three or for big parts the median of three medians
+		const int s2 = size / 2;
+		if(size > SORT_PDQ_NINTHER_LEN){
+			SORT_FN(sort3)(arr, key, begin, begin + s2, end - 1);
+			SORT_FN(sort3)(arr, key, begin + 1, begin + (s2 - 1), end - 2);
+			SORT_FN(sort3)(arr, key, begin + 2, begin + (s2 + 1), end - 3);
+			SORT_FN(sort3)(arr, key, begin + (s2 - 1), begin + s2, begin + (s2 + 1));
+			swap_keyed(arr, key, begin, begin + s2);
+		}
+		else{
+			SORT_FN(sort3)(arr, key, begin + s2, begin, end - 1);
+		}
+
+		// If the pivot's the same as the element before this part, everything equal to it can be put to one side and left
+		if(!leftmost && !SORT_TEST(key[begin], key[begin-1])){
+			begin = SORT_FN(partition_left)(arr, key, begin, end) + 1;
+			if(cb != NULL) { cb(arr, n); }
+			continue;
+		}
+
+		bool already;
+		const int pivot = SORT_FN(partition_right)(arr, key, begin, end, &already);
+		if(cb != NULL) { cb(arr, n); }
+
+		const int l_size = pivot - begin;
+		const int r_size = end - (pivot + 1);
+		if(l_size < size / 8 || r_size < size / 8){
+			if(0 == --bad_allowed){
+				SORT_FN(heap_range)(arr, key, begin, end);
+				if(cb != NULL) { cb(arr, n); }
+				return;
+			}
+			SORT_FN(pdq_shuffle)(arr, key, begin, pivot, end);
+		}
+		else if(already && SORT_FN(partial_insertion)(arr, key, begin, pivot) && SORT_FN(partial_insertion)(arr, key, pivot + 1, end)){
+			// It was very nearly in order already
+			if(cb != NULL) { cb(arr, n); }
+			return;
+		}
+
+		SORT_FN(pdq_loop)(arr, key, begin, pivot, bad_allowed, leftmost, cb, n);
+		begin = pivot + 1;
+		leftmost = false;
+	}
+}
+
+//-----------------------------------------------------
+void SORT_FN(pdq_sort)(uint32_t arr[], const int n, gif_cb cb){
+	uint32_t *key = sort_keys(arr, n);
+	int bad_allowed = 1;
+	for(int i = n; i > 1; i /= 2){ bad_allowed++; }
+	SORT_FN(pdq_loop)(arr, key, 0, n, bad_allowed, true, cb, n);
+	free(key);
+}
+
+//-----------------------------------------------------
+/// The shortest run worth merging, between 32 and 64 so the runs split the array about evenly
+static inline int SORT_FN(tim_minrun)(int n){
+	int r = 0;
+	while(n >= 64){
+		r |= n & 1;
+		n >>= 1;
+	}
+	return n + r;
+}
+
+//-----------------------------------------------------
+/// How long the run starting at lo is, reversing it if it's descending. Only strictly
+/// descending runs are reversed, so equal keys never swap places.
+static int SORT_FN(tim_run)(uint32_t arr[], uint32_t key[], const int lo, const int hi){
+	int end = lo + 1;
+	if(end == hi){ return 1; }
+
+	if(SORT_TEST(key[lo], key[end])){
+		for(end++; end < hi && SORT_TEST(key[end-1], key[end]); end++){}
+		for(int i = lo, j = end - 1; i < j; i++, j--){ swap_keyed(arr, key, i, j); }
+	}
+	else{
+		for(end++; end < hi && !SORT_TEST(key[end-1], key[end]); end++){}
+	}
+	return end - lo;
+}
+
+//-----------------------------------------------------
+/// How many of the n keys k goes after, so the equal ones stay in front of it.
+/// It looks 1, 3, 7... in, then binary searches the last gap.
+static int SORT_FN(gallop_right)(const uint32_t k, const uint32_t key[], const int n){
+	int lo = 0, hi = 1;
+	while(hi <= n && !SORT_TEST(key[hi-1], k)){
+		lo = hi;
+		hi = 2 * hi + 1;
+	}
+	if(hi > n){ hi = n; }
+	while(lo < hi){
+		const int m = lo + (hi - lo) / 2;
+		if(SORT_TEST(key[m], k)){ hi = m; }
+		else{ lo = m + 1; }
+	}
+	return lo;
+}
+
+//-----------------------------------------------------
+/// How many of the n keys go strictly before k, so the equal ones stay after it
+static int SORT_FN(gallop_left)(const uint32_t k, const uint32_t key[], const int n){
+	int lo = 0, hi = 1;
+	while(hi <= n && SORT_TEST(k, key[hi-1])){
+		lo = hi;
+		hi = 2 * hi + 1;
+	}
+	if(hi > n){ hi = n; }
+	while(lo < hi){
+		const int m = lo + (hi - lo) / 2;
+		if(SORT_TEST(k, key[m])){ lo = m + 1; }
+		else{ hi = m; }
+	}
+	return lo;
+}
+
+//-----------------------------------------------------
+/// Merge the run at a with the one after it at b. The first run is copied out to tmp and the
+/// merge goes forwards. Once one side has won min_gallop times running it gallops, copying
+/// whole stretches at a time, until galloping stops paying, and the better galloping does
+/// the sooner it starts next time.
+static void SORT_FN(tim_merge)(uint32_t arr[], uint32_t key[], uint32_t tmp[], uint32_t tmp_key[], int a, int len_a, const int b, int len_b, int * const min_gallop){
+
+	// What's already in place at either end can stay there
+	const int skip = SORT_FN(gallop_right)(key[b], &key[a], len_a);
+	a += skip;
+	len_a -= skip;
+	if(0 == len_a){ return; }
+	len_b = SORT_FN(gallop_left)(key[a + len_a - 1], &key[b], len_b);
+	if(0 == len_b){ return; }
+
+	memcpy(tmp, &arr[a], len_a * sizeof(*tmp));
+	memcpy(tmp_key, &key[a], len_a * sizeof(*tmp_key));
+
+	int i = 0, j = b, dest = a;
+	const int end_b = b + len_b;
+	while(i < len_a && j < end_b){
+		int count_a = 0, count_b = 0;
+		while(i < len_a && j < end_b && (count_a | count_b) < *min_gallop){
+			if(SORT_TEST(tmp_key[i], key[j])){
+				SORT_FN(put)(arr, key, dest++, arr[j], key[j]);
+				j++;
+				count_b++;
+				count_a = 0;
+			}
+			else{
+				SORT_FN(put)(arr, key, dest++, tmp[i], tmp_key[i]);
+				i++;
+				count_a++;
+				count_b = 0;
+			}
+		}
+
+		while(i < len_a && j < end_b){
+			count_a = SORT_FN(gallop_right)(key[j], &tmp_key[i], len_a - i);
+			for(int c = 0; c < count_a; c++, i++){ SORT_FN(put)(arr, key, dest++, tmp[i], tmp_key[i]); }
+			if(i == len_a){ break; }
+
+			count_b = SORT_FN(gallop_left)(tmp_key[i], &key[j], end_b - j);
+			for(int c = 0; c < count_b; c++, j++){ SORT_FN(put)(arr, key, dest++, arr[j], key[j]); }
+			if(j == end_b){ break; }
+
+			if(*min_gallop > 1){ (*min_gallop)--; }
+			if(count_a < SORT_TIM_MIN_GALLOP && count_b < SORT_TIM_MIN_GALLOP){
+				*min_gallop += 2;
+				break;
+			}
+		}
+	}
+
+	// The rest of the second run is already where it belongs
+	for(; i < len_a; i++){ SORT_FN(put)(arr, key, dest++, tmp[i], tmp_key[i]); }
+}
+
+//-----------------------------------------------------
+void SORT_FN(tim_sort)(uint32_t arr[], const int n, gif_cb cb){
+	uint32_t *key = sort_keys(arr, n);
+	uint32_t *tmp = alloc_aligned((size_t)n * 2 * sizeof(*tmp));
+	assert(tmp);
+	uint32_t *tmp_key = tmp + n;
+
+	int base[SORT_TIM_STACK_LEN], len[SORT_TIM_STACK_LEN];
+	int runs = 0;
+	int min_gallop = SORT_TIM_MIN_GALLOP;
+	const int min_run = SORT_FN(tim_minrun)(n);
+
+	for(int lo = 0; lo < n; ){
+		int run = SORT_FN(tim_run)(arr, key, lo, n);
+		if(run < min_run){
+			const int force = n - lo < min_run ? n - lo : min_run;
+			SORT_FN(insertion_range)(arr, key, lo, lo + force, lo + run);
+			run = force;
+		}
+		base[runs] = lo;
+		len[runs++] = run;
+		lo += run;
+		if(cb != NULL) { cb(arr, n); }
+
+		// Keep the run lengths growing at least as fast as Fibonacci down the stack, so it
+		// stays short and the merges stay balanced. Once there are no more runs they all go.
+		while(runs > 1){
+			int k = runs - 2;
+			if(lo < n){
+				if((k > 0 && len[k-1] <= len[k] + len[k+1]) || (k > 1 && len[k-2] <= len[k-1] + len[k])){
+					if(len[k-1] < len[k+1]){ k--; }
+				}
+				else if(len[k] > len[k+1]){ break; }
+			}
+			else if(k > 0 && len[k-1] < len[k+1]){ k--; }
+
+			SORT_FN(tim_merge)(arr, key, tmp, tmp_key, base[k], len[k], base[k+1], len[k+1], &min_gallop);
+			len[k] += len[k+1];
+			for(int r = k + 1; r < runs - 1; r++){
+				base[r] = base[r+1];
+				len[r] = len[r+1];
+			}
+			runs--;
+			if(cb != NULL) { cb(arr, n); }
+		}
+	}
+
+	free(tmp);
+	free(key);
+}
+
+//-----------------------------------------------------
+void SORT_FN(shell_sort)(uint32_t arr[], const int n, gif_cb cb){
+	static const int ciura[] = { 1, 4, 10, 23, 57, 132, 301, 701, 1750 };
+	int gaps[64];
+	int count = 0;
+	for(; count < (int)(sizeof(ciura) / sizeof(*ciura)) && ciura[count] < n; count++){ gaps[count] = ciura[count]; }
+	if(count == (int)(sizeof(ciura) / sizeof(*ciura))){
+		for(long gap = ciura[count - 1] * 9L / 4; gap < n; gap = gap * 9 / 4){ gaps[count++] = (int)gap; }
+	}
+
+	// However small the gap, a pass only gets so many frames
+	const int every = n / SORT_SHELL_PASS_FRAMES > 0 ? n / SORT_SHELL_PASS_FRAMES : 1;
+
+	uint32_t *key = sort_keys(arr, n);
+	while(count-- > 0){
+		const int gap = gaps[count];
+		for(int i = gap; i < n; i++){
+			const uint32_t v = arr[i];
+			const uint32_t vk = key[i];
+			int j = i;
+			for(; j >= gap && SORT_TEST(key[j-gap], vk); j -= gap){
+				SORT_FN(put)(arr, key, j, arr[j-gap], key[j-gap]);
+			}
+			if(j != i){ SORT_FN(put)(arr, key, j, v, vk); }
+
+			if(cb != NULL && i % every == every - 1 && i + 1 < n) { cb(arr, n); }
+		}
+		if(cb != NULL) { cb(arr, n); }
+	}
+	free(key);
+}
+
+//-----------------------------------------------------
+void SORT_FN(all_sort)(uint32_t arr[], const int n, gif_cb cb){
+	const int lanes = (int)sorter_count - 1;
+
+	if(NULL == trace_out){
+		sort_fn fn[lanes];
+		for(int i = 0; i < lanes; i++){ fn[i] = sorters[i].perform[SORT_ORDER]; }
+		if(!race_sort(arr, n, fn, lanes, cb)){
+			fprintf(stderr, "[%d] Couldn't race the sorts, the array is untouched\n", __LINE__);
+		}
+		return;
+	}
+
+	uint32_t *other_arr = malloc(n * sizeof(*arr));
+	assert(other_arr);
+	memcpy(other_arr, arr, n * sizeof(*arr));
+
+	// Each sort after the first starts over from the same array, the last one's result stays
+	for(int i = 0; i < lanes; i++){
+		sorters[i].perform[SORT_ORDER](arr, n, cb);
+		if(i + 1 < lanes){
+			memcpy(arr, other_arr, n * sizeof(*arr));
+			for(int k = 0; k < n; k++){ trace_write(trace_out, k, arr[k]); }
+		}
+	}
+	free(other_arr);
+}
+
+#endif /* SORT_KERNEL_BODIES */
+
+#undef SORT_FN
+#undef SORT_CAT
+#undef SORT_CAT_
+#undef SORT_SUFFIX
+#undef SORT_ORDER
+#undef SORT_TEST
@@ -0,0 +1,34 @@
+//
+//  stats.c
+//  Visualiser
+//
+
+#include "stats.h"
+
+//-----------------------------------------------------
+/// The sort's own time, which can't go below 0 even if the clock is coarse
+static double stats_sort_ms(const struct stats * const s){
+	const double ms = s->phase_ms[STATS_SORT] - s->phase_ms[STATS_FRAMES];
+	return ms > 0 ? ms : 0;
+}
+
+//-----------------------------------------------------
+void stats_print(const struct stats * const s, const struct sort_counters * const counts, FILE * const out){
+	fprintf(out, "Compares:     %lu\n", counts->compares);
+	fprintf(out, "Swaps:        %lu\n", counts->swaps);
+	fprintf(out, "Writes:       %lu\n", counts->writes);
+	fprintf(out, "Frames:       %lu\n", s->frames);
+	fprintf(out, "Repeats:      %lu\n", s->repeats);
+	fprintf(out, "Sorting:      %.3fms\n", stats_sort_ms(s));
+	fprintf(out, "In frames:    %.3fms\n", s->phase_ms[STATS_FRAMES]);
+	fprintf(out, "  Building:   %.3fms\n", s->phase_ms[STATS_BUILD]);
+	fprintf(out, "  Encoding:   %.3fms\n", s->phase_ms[STATS_ENCODE]);
+}
+
+//-----------------------------------------------------
+void stats_write_json(const struct stats * const s, const struct sort_counters * const counts, FILE * const out){
+	fprintf(out, "{\"compares\": %lu, \"swaps\": %lu, \"writes\": %lu, \"frames\": %lu, \"repeats\": %lu, "
+			"\"sort_ms\": %.3f, \"frames_ms\": %.3f, \"build_ms\": %.3f, \"encode_ms\": %.3f}\n",
+			counts->compares, counts->swaps, counts->writes, s->frames, s->repeats,
+			stats_sort_ms(s), s->phase_ms[STATS_FRAMES], s->phase_ms[STATS_BUILD], s->phase_ms[STATS_ENCODE]);
+}
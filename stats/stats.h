@@ -0,0 +1,90 @@
+//
+//  stats.h
+//  Visualiser
+//
+//  Where the time goes in a run. The sort's own time is what's left of the sort call
+//  once the time it spent handing frames over is taken out. Building and encoding are
+//  timed in the frame writers, which run on the encoder thread with -t. With -j the
+//  encode time is only handing the frame to the pool, the compressing isn't counted.
+//
+
+#ifndef stats_h
+#define stats_h
+
+#include <stdio.h>
+#include <stdbool.h>
+#include <time.h>
+
+#include "sort.h"
+
+/// The parts of a run which get timed
+enum stats_phase{
+	STATS_SORT = 0,		///< The whole sort call, frames and all
+	STATS_FRAMES,		///< Inside the frame callback, as the sort sees it
+	STATS_BUILD,		///< Laying out a frame's pixels or indices
+	STATS_ENCODE,		///< Compressing and writing it
+	STATS_PHASES
+};
+
+/**
+ The timers and the frame count. Nothing is timed unless enabled is set.
+ */
+struct stats{
+	bool			enabled;
+	unsigned long	frames;						///< Frames which made it to a writer
+	unsigned long	repeats;					///< Frames the same as the one before, which just made that one last longer
+	double			phase_ms[STATS_PHASES];		///< Time spent in each so far
+	double			since[STATS_PHASES];		///< When each was last entered
+};
+
+//-----------------------------------------------------
+/**
+ The time now
+
+ @return Milliseconds from some fixed point
+ */
+static inline double stats_now_ms(void){
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec * 1e3 + ts.tv_nsec / 1e6;
+}
+
+/**
+ Start timing a phase
+
+ @param s The stats
+ @param phase Which one
+ */
+static inline void stats_begin(struct stats * const s, const enum stats_phase phase){
+	if(s->enabled){ s->since[phase] = stats_now_ms(); }
+}
+
+/**
+ Stop timing a phase, adding how long it took
+
+ @param s The stats
+ @param phase Which one
+ */
+static inline void stats_end(struct stats * const s, const enum stats_phase phase){
+	if(s->enabled){ s->phase_ms[phase] += stats_now_ms() - s->since[phase]; }
+}
+
+/**
+ Print a summary for people
+
+ @param s The stats
+ @param counts What the sort did
+ @param out Where to
+ */
+void	stats_print(const struct stats * const s, const struct sort_counters * const counts, FILE * const out);
+
+/**
+ Write the same as a JSON object
+
+ @param s The stats
+ @param counts What the sort did
+ @param out Where to
+ */
+void	stats_write_json(const struct stats * const s, const struct sort_counters * const counts, FILE * const out);
+
+#endif /* stats_h */
@@ -0,0 +1,225 @@
+//
+//  trace.c
+//  Visualiser
+//
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "trace.h"
+
+#define TRACE_IO_BUFF_LEN					(1 << 20)
+
+//-----------------------------------------------------
+static void trace_put_u32(FILE * const fp, const uint32_t v){
+	fputc(v & 0xFF, fp);
+	fputc((v >> 8) & 0xFF, fp);
+	fputc((v >> 16) & 0xFF, fp);
+	fputc((v >> 24) & 0xFF, fp);
+}
+
+//-----------------------------------------------------
+static bool trace_get_u32(FILE * const fp, uint32_t * const v){
+	uint8_t b[4];
+	if(1 != fread(b, sizeof(b), 1, fp)){ return false; }
+	*v = b[0] | (b[1] << 8) | (b[2] << 16) | ((uint32_t)b[3] << 24);
+	return true;
+}
+
+//-----------------------------------------------------
+static void trace_put_varint(FILE * const fp, uint32_t v){
+	while(v >= 0x80){
+		fputc((v & 0x7F) | 0x80, fp);
+		v >>= 7;
+	}
+	fputc(v, fp);
+}
+
+//-----------------------------------------------------
+static bool trace_get_varint(FILE * const fp, uint32_t * const v){
+	*v = 0;
+	for(int shift = 0; shift < 35; shift += 7){
+		const int c = fgetc(fp);
+		if(c == EOF){ return false; }
+		*v |= (uint32_t)(c & 0x7F) << shift;
+		if(!(c & 0x80)){ return true; }
+	}
+	return false;
+}
+
+//-----------------------------------------------------
+bool trace_begin(struct trace * const t, const char * const filename, uint32_t arr[], const int n){
+
+	t->fp = fopen(filename, "wb");
+	if(!t->fp){
+		perror("Error opening file\n");
+		return false;
+	}
+	setvbuf(t->fp, NULL, _IOFBF, TRACE_IO_BUFF_LEN);
+	t->arr = arr;
+	t->n = n;
+	t->replay = false;
+
+	fputs(TRACE_MAGIC, t->fp);
+	fputc(TRACE_VERSION, t->fp);
+	trace_put_u32(t->fp, (uint32_t)n);
+	for(int i = 0; i < n; i++){
+		trace_put_u32(t->fp, arr[i]);
+	}
+	return true;
+}
+
+//-----------------------------------------------------
+void trace_swap(struct trace * const t, const uint32_t a, const uint32_t b){
+	fputc(TRACE_OP_SWAP, t->fp);
+	trace_put_varint(t->fp, a);
+	trace_put_varint(t->fp, b);
+}
+
+//-----------------------------------------------------
+void trace_write(struct trace * const t, const uint32_t i, const uint32_t value){
+	fputc(TRACE_OP_WRITE, t->fp);
+	trace_put_varint(t->fp, i);
+	trace_put_varint(t->fp, value);
+}
+
+//-----------------------------------------------------
+void trace_compare(struct trace * const t){
+	fputc(TRACE_OP_COMPARE, t->fp);
+}
+
+//-----------------------------------------------------
+void trace_frame(struct trace * const t){
+	fputc(TRACE_OP_FRAME, t->fp);
+}
+
+//-----------------------------------------------------
+bool trace_end(struct trace * const t){
+	if(!t->fp){ return false; }
+	const bool ok = !ferror(t->fp);
+	fclose(t->fp);
+	t->fp = NULL;
+	if(t->replay){
+		free(t->arr);
+		t->arr = NULL;
+	}
+	return ok;
+}
+
+//-----------------------------------------------------
+bool trace_open(struct trace * const t, const char * const filename){
+
+	char magic[sizeof(TRACE_MAGIC) - 1];
+	uint32_t n = 0;
+
+	memset(t, 0, sizeof(*t));
+	t->fp = fopen(filename, "rb");
+	if(!t->fp){
+		perror("Error opening file\n");
+		return false;
+	}
+	setvbuf(t->fp, NULL, _IOFBF, TRACE_IO_BUFF_LEN);
+	t->replay = true;
+
+	if(1 != fread(magic, sizeof(magic), 1, t->fp) || 0 != memcmp(magic, TRACE_MAGIC, sizeof(magic))
+	   || TRACE_VERSION != fgetc(t->fp) || !trace_get_u32(t->fp, &n) || n == 0){
+		fprintf(stderr, "%s isn't a trace file\n", filename);
+		trace_end(t);
+		return false;
+	}
+
+	t->n = (int)n;
+	t->arr = malloc(n * sizeof(*t->arr));
+	if(!t->arr){
+		fprintf(stderr, "[%d] Out of memory for %u elements\n", __LINE__, n);
+		trace_end(t);
+		return false;
+	}
+	for(uint32_t i = 0; i < n; i++){
+		if(!trace_get_u32(t->fp, &t->arr[i])){
+			fprintf(stderr, "%s is truncated\n", filename);
+			trace_end(t);
+			return false;
+		}
+	}
+	return true;
+}
+
+//-----------------------------------------------------
+enum trace_op trace_next(struct trace * const t, struct trace_event * const ev){
+
+	const int c = fgetc(t->fp);
+	ev->op = TRACE_OP_END;
+	ev->a = ev->b = 0;
+
+	switch(c){
+		case EOF:
+			break;
+		case TRACE_OP_SWAP:
+		case TRACE_OP_WRITE:
+			ev->op = (enum trace_op)c;
+			if(!trace_get_varint(t->fp, &ev->a) || !trace_get_varint(t->fp, &ev->b) || ev->a >= (uint32_t)t->n
+			   || (c == TRACE_OP_SWAP && ev->b >= (uint32_t)t->n)){
+				ev->op = TRACE_OP_ERROR;
+			}
+			break;
+		case TRACE_OP_COMPARE:
+		case TRACE_OP_FRAME:
+			ev->op = (enum trace_op)c;
+			break;
+		default:
+			ev->op = TRACE_OP_ERROR;
+			break;
+	}
+	return ev->op;
+}
+
+//-----------------------------------------------------
+long trace_replay(struct trace * const t, const unsigned long every, trace_value_cb fix, trace_frame_cb cb){
+
+	struct trace_event ev;
+	unsigned long ops = 0;
+	long frames = 1;
+
+	cb(t->arr, t->n);
+
+	for(;;){
+		switch(trace_next(t, &ev)){
+			case TRACE_OP_SWAP:{
+				const uint32_t tmp = t->arr[ev.a];
+				t->arr[ev.a] = t->arr[ev.b];
+				t->arr[ev.b] = tmp;
+				ops++;
+				break;
+			}
+			case TRACE_OP_WRITE:
+				t->arr[ev.a] = fix ? fix(ev.b) : ev.b;
+				ops++;
+				break;
+			case TRACE_OP_COMPARE:
+				ops++;
+				break;
+			case TRACE_OP_FRAME:
+				if(every == 0){
+					cb(t->arr, t->n);
+					frames++;
+				}
+				break;
+			case TRACE_OP_END:
+				// Make sure the end state gets shown
+				if(every != 0 && ops % every != 0){
+					cb(t->arr, t->n);
+					frames++;
+				}
+				return frames;
+			case TRACE_OP_ERROR:
+				fprintf(stderr, "The trace is broken after %lu operations\n", ops);
+				return -1;
+		}
+
+		if(every != 0 && ops != 0 && ops % every == 0 && ev.op != TRACE_OP_FRAME){
+			cb(t->arr, t->n);
+			frames++;
+		}
+	}
+}
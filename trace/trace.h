@@ -0,0 +1,139 @@
+//
+//  trace.h
+//  Visualiser
+//
+//  Records what a sort did to the array as a compact binary stream, so it can be
+//  rendered later at whatever size or frame rate without running the sort again.
+//
+//  File layout, all little endian:
+//      "VTRC" version(u8) n(u32) then n initial values (u32)
+//      then events, each an opcode byte followed by its operands as LEB128 varints
+//
+
+#ifndef trace_h
+#define trace_h
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdio.h>
+
+#define TRACE_MAGIC							"VTRC"
+#define TRACE_VERSION						1
+
+/// Things a sort can do
+enum trace_op{
+	TRACE_OP_END = 0,		///< Not stored, returned at the end of the file
+	TRACE_OP_SWAP,			///< a and b swapped places
+	TRACE_OP_WRITE,			///< arr[a] = b
+	TRACE_OP_COMPARE,		///< Two keys were compared, no operands
+	TRACE_OP_FRAME,			///< The sort asked for a frame here
+	TRACE_OP_ERROR			///< Not stored, returned if the file is broken
+};
+
+/**
+ An event read back out
+ */
+struct trace_event{
+	enum trace_op	op;
+	uint32_t		a;
+	uint32_t		b;
+};
+
+/**
+ A trace being recorded or played back
+ */
+struct trace{
+	FILE			*fp;
+	int				n;
+	uint32_t		*arr;		///< Recording: the array being sorted. Replaying: our own copy of it.
+	bool			replay;		///< Whether arr is ours to free
+};
+
+/// Called with the array at each frame of a replay
+typedef void (*trace_frame_cb)(const uint32_t arr[], const int n);
+
+/// Lets the renderer adjust values as they're written back in, eg to tag them with palette indices
+typedef uint32_t (*trace_value_cb)(const uint32_t value);
+
+//-----------------------------------------------------
+/**
+ Create the file and store the starting array in it
+
+ @param t The trace
+ @param filename Where to write to
+ @param arr The array that is about to be sorted, indices are relative to this
+ @param n The length of it
+ @return Success or not
+ */
+bool	trace_begin(struct trace * const t, const char * const filename, uint32_t arr[], const int n);
+
+/**
+ Record a swap
+
+ @param t The trace
+ @param a One index
+ @param b The other
+ */
+void	trace_swap(struct trace * const t, const uint32_t a, const uint32_t b);
+
+/**
+ Record a write of a value into the array
+
+ @param t The trace
+ @param i The index
+ @param value What went there
+ */
+void	trace_write(struct trace * const t, const uint32_t i, const uint32_t value);
+
+/**
+ Record a comparison
+
+ @param t The trace
+ */
+void	trace_compare(struct trace * const t);
+
+/**
+ Record that a frame would have been written here
+
+ @param t The trace
+ */
+void	trace_frame(struct trace * const t);
+
+/**
+ Close the file, either direction
+
+ @param t The trace
+ @return Success or not
+ */
+bool	trace_end(struct trace * const t);
+
+/**
+ Open a trace and read in the starting array
+
+ @param t The trace
+ @param filename What to read
+ @return Success or not
+ */
+bool	trace_open(struct trace * const t, const char * const filename);
+
+/**
+ Read the next event without applying it
+
+ @param t The trace
+ @param ev Where to put it
+ @return The op, TRACE_OP_END at the end or TRACE_OP_ERROR
+ */
+enum trace_op trace_next(struct trace * const t, struct trace_event * const ev);
+
+/**
+ Play the rest of the trace back onto t->arr, calling cb with the starting array and then at every frame
+
+ @param t An opened trace
+ @param every Make a frame every this many swaps, writes and compares. 0 to use the recorded frames.
+ @param fix Applied to every written value, can be NULL
+ @param cb Where the frames go
+ @return How many frames were made, or -1 if the file was broken
+ */
+long	trace_replay(struct trace * const t, const unsigned long every, trace_value_cb fix, trace_frame_cb cb);
+
+#endif /* trace_h */